@@ -0,0 +1,229 @@
+/*
+ * hotpath.c — Hot-path check for the replay harness (see hotpath.h)
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "hotpath.h"
+
+#define EXIT_NO_SECCOMP 77
+
+static struct hotpath_report *g_report;   /* shared with the parent */
+static __thread int g_armed;              /* this thread is being checked */
+static long g_where;
+
+void hotpath_mark(long where)
+{
+    g_where = where;
+}
+
+/* ── Heap ─────────────────────────────────────────────────── */
+
+/* Defined here, these take precedence over libc's for every object
+ * in the process, the dlopen'ed engine included.                 */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void  __libc_free(void *p);
+extern void *__libc_memalign(size_t align, size_t size);
+
+static void heap_op(const char *fn)
+{
+    if (!g_armed)
+        return;
+    if (g_report->heap++ == 0) {
+        g_report->first_heap = fn;   /* a literal: same address after fork */
+        g_report->heap_at = g_where;
+    }
+}
+
+void *malloc(size_t size)
+{
+    heap_op("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    heap_op("calloc");
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+    heap_op("realloc");
+    return __libc_realloc(p, size);
+}
+
+void free(void *p)
+{
+    if (p)
+        heap_op("free");
+    __libc_free(p);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    heap_op("memalign");
+    return __libc_memalign(align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    heap_op("aligned_alloc");
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void **p, size_t align, size_t size)
+{
+    heap_op("posix_memalign");
+    if (align < sizeof(void *) || (align & (align - 1)))
+        return EINVAL;
+    *p = __libc_memalign(align, size);
+    return *p ? 0 : ENOMEM;
+}
+
+/* ── System calls ─────────────────────────────────────────── */
+
+/* The trapped call is not executed; it returns -ENOSYS */
+static void on_sigsys(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    (void)sig;
+    if (g_report->syscalls++ == 0) {
+        g_report->first_syscall = si->si_syscall;
+        g_report->syscall_at = g_where;
+    }
+#if defined(__x86_64__)
+    uc->uc_mcontext.gregs[REG_RAX] = -ENOSYS;
+#elif defined(__aarch64__)
+    uc->uc_mcontext.regs[0] = -ENOSYS;
+#endif
+}
+
+/* Everything traps except returning from the handler and exiting */
+static int trap_syscalls(void)
+{
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_rt_sigreturn, 2, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_exit_group, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog prog = {
+        .len = sizeof(filter) / sizeof(filter[0]),
+        .filter = filter,
+    };
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_sigsys;
+    sa.sa_flags = SA_SIGINFO;
+    if (sigaction(SIGSYS, &sa, NULL) != 0 ||
+        prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 ||
+        prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) != 0)
+        return -1;
+    return 0;
+}
+
+/* ── API ──────────────────────────────────────────────────── */
+
+int hotpath_run(void (*fn)(void *), void *arg, struct hotpath_report *r)
+{
+#if !defined(__x86_64__) && !defined(__aarch64__)
+    (void)fn; (void)arg; (void)r;
+    return -1;
+#else
+    g_report = mmap(NULL, sizeof(*g_report), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_report == MAP_FAILED)
+        return -1;
+    memset(g_report, 0, sizeof(*g_report));
+    g_report->first_syscall = -1;
+    g_report->heap_at = g_report->syscall_at = -1;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        munmap(g_report, sizeof(*g_report));
+        return -1;
+    }
+    if (pid == 0) {
+        if (trap_syscalls() != 0)
+            _exit(EXIT_NO_SECCOMP);
+        g_armed = 1;
+        fn(arg);
+        g_armed = 0;
+        _exit(0);
+    }
+
+    int st, rc = -1;
+    if (waitpid(pid, &st, 0) == pid && WIFEXITED(st) &&
+        WEXITSTATUS(st) != EXIT_NO_SECCOMP) {
+        if (WEXITSTATUS(st) != 0)
+            fprintf(stderr, "hotpath: check exited with %d\n",
+                    WEXITSTATUS(st));
+        *r = *g_report;
+        rc = 0;
+    } else if (WIFSIGNALED(st)) {
+        fprintf(stderr, "hotpath: check killed by signal %d\n",
+                WTERMSIG(st));
+    }
+    munmap(g_report, sizeof(*g_report));
+    return rc;
+#endif
+}
+
+const char *hotpath_syscall_name(long nr)
+{
+    static const struct { long nr; const char *name; } names[] = {
+#ifdef SYS_open
+        { SYS_open, "open" },
+#endif
+#ifdef SYS_stat
+        { SYS_stat, "stat" },
+#endif
+#ifdef SYS_readlink
+        { SYS_readlink, "readlink" },
+#endif
+#ifdef SYS_time
+        { SYS_time, "time" },
+#endif
+        { SYS_openat, "openat" },
+        { SYS_read, "read" },
+        { SYS_write, "write" },
+        { SYS_close, "close" },
+        { SYS_fstat, "fstat" },
+        { SYS_newfstatat, "newfstatat" },
+        { SYS_statx, "statx" },
+        { SYS_readlinkat, "readlinkat" },
+        { SYS_lseek, "lseek" },
+        { SYS_mmap, "mmap" },
+        { SYS_munmap, "munmap" },
+        { SYS_brk, "brk" },
+        { SYS_futex, "futex" },
+        { SYS_sched_yield, "sched_yield" },
+        { SYS_clock_gettime, "clock_gettime" },
+        { SYS_gettimeofday, "gettimeofday" },
+        { SYS_getpid, "getpid" },
+        { SYS_ppoll, "ppoll" },
+        { SYS_nanosleep, "nanosleep" },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        if (names[i].nr == nr)
+            return names[i].name;
+    return "?";
+}
@@ -0,0 +1,47 @@
+/*
+ * hotpath.h — Hot-path check for the replay harness (scroll-replay -z)
+ *
+ * Counts heap operations and system calls inside a section.
+ *
+ *   heap      This program defines malloc/calloc/realloc/free and the
+ *             rest itself and forwards them to glibc's __libc_*.  Calls
+ *             from the shim and the engine go through them, and so do
+ *             libc's own (fopen's buffer and such).
+ *   syscall   A seccomp filter on the thread running the section turns
+ *             every system call into SIGSYS, which records its number
+ *             and returns -ENOSYS.  Caught at the kernel's entry, not
+ *             in wrappers, so calls from inside libc and syscall() are
+ *             not missed.  The vDSO's clock_gettime and time are not
+ *             system calls and are not counted.
+ *
+ * A filter cannot be removed, so the section runs in a forked child
+ * and the results come back through shared memory.  The child must do
+ * nothing but the getter calls (printf would be counted, and fail).
+ * x86_64 and aarch64 only.
+ */
+
+#ifndef HOTPATH_H
+#define HOTPATH_H
+
+#include <stdint.h>
+
+struct hotpath_report {
+    uint64_t    heap;            /* heap operations */
+    uint64_t    syscalls;
+    const char *first_heap;      /* function name, NULL = none */
+    long        first_syscall;   /* number, -1 = none */
+    long        heap_at;         /* hotpath_mark() at the first of each */
+    long        syscall_at;
+};
+
+/* Run fn(arg) in a forked child, counting.  0 = it ran (results in
+ * *r), -1 = no seccomp.  The child inherits the parent's state (the
+ * engine already loaded and so on).                               */
+int hotpath_run(void (*fn)(void *), void *arg, struct hotpath_report *r);
+
+/* Where later violations are reported to be (an event number, say) */
+void hotpath_mark(long where);
+
+const char *hotpath_syscall_name(long nr);
+
+#endif
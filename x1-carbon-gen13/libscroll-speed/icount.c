@@ -0,0 +1,177 @@
+/*
+ * icount.c — Deterministic instruction counter for replay (see icount.h)
+ */
+
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "icount.h"
+
+#define CALIBRATE_RUNS 16
+
+static enum icount_method g_method;
+static int g_fd[2] = { -1, -1 };     /* perf: instructions (leader), branches */
+static volatile uint64_t *g_steps;   /* ptrace: written by the tracer */
+static uint64_t g_base[2];           /* cost of an empty region */
+
+/* ── perf_event_open ──────────────────────────────────────── */
+
+static int perf_open(uint64_t config, int leader)
+{
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof(a);
+    a.config = config;
+    a.disabled = leader < 0;   /* members follow the leader */
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    a.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, leader, 0);
+}
+
+static void perf_read(uint64_t out[2])
+{
+    uint64_t buf[3] = { 0, 0, 0 };   /* nr, values[] */
+    if (read(g_fd[0], buf, sizeof(buf)) < (ssize_t)(2 * sizeof(uint64_t)))
+        buf[0] = 0;
+    out[0] = buf[0] >= 1 ? buf[1] : 0;
+    out[1] = buf[0] >= 2 ? buf[2] : UINT64_MAX;
+}
+
+/* ── ptrace single-step ───────────────────────────────────── */
+
+/* The child runs the harness and marks regions with SIGUSR1/SIGUSR2,
+ * which the tracer swallows; in between it steps and counts. */
+__attribute__((noreturn))
+static void tracer(pid_t child)
+{
+    int stepping = 0;
+    uint64_t steps = 0;
+    for (;;) {
+        int st;
+        if (waitpid(child, &st, 0) < 0) {
+            perror("icount: waitpid");
+            _exit(1);
+        }
+        if (WIFEXITED(st))
+            _exit(WEXITSTATUS(st));
+        if (WIFSIGNALED(st)) {
+            fprintf(stderr, "icount: harness killed by signal %d\n",
+                    WTERMSIG(st));
+            _exit(1);
+        }
+
+        int sig = WSTOPSIG(st), deliver = 0;
+        if (sig == SIGSTOP && !stepping) {
+            /* the child's initial stop */
+            ptrace(PTRACE_SETOPTIONS, child, 0, (void *)PTRACE_O_EXITKILL);
+        } else if (sig == SIGUSR1) {
+            stepping = 1;
+            steps = 0;
+        } else if (sig == SIGUSR2) {
+            stepping = 0;
+            *g_steps = steps;
+        } else if (sig == SIGTRAP && stepping) {
+            steps++;
+        } else {
+            deliver = sig;
+        }
+        ptrace(stepping ? PTRACE_SINGLESTEP : PTRACE_CONT, child, 0,
+               (void *)(long)deliver);
+    }
+}
+
+static int ptrace_init(void)
+{
+    g_steps = mmap(NULL, sizeof(*g_steps), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_steps == MAP_FAILED)
+        return -1;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid > 0)
+        tracer(pid);
+
+    /* Without a tracer the parent just waits for us to exit */
+    if (ptrace(PTRACE_TRACEME, 0, 0, 0) < 0)
+        return -1;
+    raise(SIGSTOP);
+    return 0;
+}
+
+/* ── API ──────────────────────────────────────────────────── */
+
+static void region(uint64_t out[2])
+{
+    if (g_method == ICOUNT_PERF) {
+        ioctl(g_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        perf_read(out);
+    } else {
+        raise(SIGUSR2);
+        out[0] = *g_steps;
+        out[1] = UINT64_MAX;
+    }
+}
+
+enum icount_method icount_init(void)
+{
+    if ((g_fd[0] = perf_open(PERF_COUNT_HW_INSTRUCTIONS, -1)) >= 0) {
+        g_fd[1] = perf_open(PERF_COUNT_HW_BRANCH_INSTRUCTIONS, g_fd[0]);
+        g_method = ICOUNT_PERF;
+    } else if (ptrace_init() == 0) {
+        g_method = ICOUNT_PTRACE;
+    } else {
+        return g_method = ICOUNT_NONE;
+    }
+
+    /* Entering and leaving a region costs the same every time */
+    g_base[0] = g_base[1] = UINT64_MAX;
+    for (int i = 0; i < CALIBRATE_RUNS; i++) {
+        uint64_t c[2];
+        icount_begin();
+        region(c);
+        for (int k = 0; k < 2; k++)
+            if (c[k] < g_base[k])
+                g_base[k] = c[k];
+    }
+    return g_method;
+}
+
+const char *icount_method_name(enum icount_method m)
+{
+    return m == ICOUNT_PERF ? "perf" : m == ICOUNT_PTRACE ? "ptrace" : "none";
+}
+
+void icount_begin(void)
+{
+    if (g_method == ICOUNT_PERF) {
+        ioctl(g_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(g_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    } else if (g_method == ICOUNT_PTRACE) {
+        raise(SIGUSR1);
+    }
+}
+
+void icount_end(uint64_t *insns, uint64_t *branches)
+{
+    uint64_t c[2] = { 0, UINT64_MAX };
+    if (g_method != ICOUNT_NONE)
+        region(c);
+    *insns = c[0] > g_base[0] ? c[0] - g_base[0] : 0;
+    *branches = c[1] == UINT64_MAX ? UINT64_MAX
+              : c[1] > g_base[1] ? c[1] - g_base[1] : 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * icount.h — Deterministic instruction counter for the replay harness
+ *
+ * Counts the user-space instructions (and branches) run between
+ * icount_begin() and icount_end().  Unlike wall-clock benchmarks on a
+ * laptop, the same build and trace always give the same numbers, so
+ * they can gate performance (make perf-gate).
+ *
+ *   perf    instructions:u / branches:u from perf_event_open
+ *   ptrace  for machines without hardware counters (VMs and such):
+ *           the harness runs in a child, which the parent single-steps
+ *           through each section.  No branch counts; several µs per
+ *           instruction.
+ *
+ * Both subtract the cost of entering and leaving a section (the
+ * minimum over empty sections).
+ */
+
+#ifndef ICOUNT_H
+#define ICOUNT_H
+
+#include <stdint.h>
+
+enum icount_method { ICOUNT_NONE, ICOUNT_PERF, ICOUNT_PTRACE };
+
+/* Set up the counters.  With ptrace this forks, and only the child
+ * (the one measured) returns to the caller; the parent traces it
+ * until it exits and exits with its status.  Call before the first
+ * getter call (before any thread is created).                     */
+enum icount_method icount_init(void);
+const char *icount_method_name(enum icount_method m);
+
+void icount_begin(void);
+/* Instructions and branches since the last icount_begin() (branches
+ * with perf only, UINT64_MAX otherwise).                          */
+void icount_end(uint64_t *insns, uint64_t *branches);
+
+#endif
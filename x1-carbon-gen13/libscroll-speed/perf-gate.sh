@@ -0,0 +1,98 @@
+#!/usr/bin/env bash
+# perf-gate.sh — 命令数による性能ゲート（make perf-gate / make test から呼ばれる）
+#
+# BASE_DIR と NEW_DIR にあるシム・エンジンに、同じトレースを同じ設定で
+# scroll-replay -c で流し、getter ごとの1イベントあたり命令数
+# （perf が使えれば分岐数も）を比較します。壁時計と違いノイズがないので、
+# 小さな退行も検出できます。
+#
+# NEW が BASE より TOLERANCE % を超えて多いものがあれば終了コード 1。
+# 命令数カウンタが使えない環境ではスキップ（終了コード 0）。
+#
+# 使い方: perf-gate.sh BASE_DIR NEW_DIR TOLERANCE CONF... -- TRACE...
+
+set -uo pipefail
+
+REPLAY="./scroll-replay"
+TARGET="libscroll-speed.so"
+ENGINE="libscroll-speed-engine.so"
+SKIP=77
+
+ok()    { echo -e "\033[1;32m[OK]\033[0m    $*"; }
+warn()  { echo -e "\033[1;33m[WARN]\033[0m  $*"; }
+err()   { echo -e "\033[1;31m[ERROR]\033[0m $*" >&2; }
+
+if [[ $# -lt 6 ]]; then
+    err "使い方: $0 BASE_DIR NEW_DIR TOLERANCE CONF... -- TRACE..."
+    exit 2
+fi
+base_dir=$(realpath "$1") new_dir=$(realpath "$2") tolerance=$3
+shift 3
+confs=()
+while [[ $# -gt 0 && $1 != -- ]]; do confs+=("$1"); shift; done
+shift
+traces=("$@")
+
+# DIR CONF TRACE → icount 行
+run() {
+    SCROLL_SPEED_CONF="$2" SCROLL_SPEED_ENGINE="$1/$ENGINE" \
+        LD_PRELOAD="$1/$TARGET" "$REPLAY" -c "$3" > "$out" 2>&1
+    local rc=$?
+    if [[ $rc == "$SKIP" ]]; then
+        warn "命令数カウンタなし（perf_event_open・ptrace とも不可）: スキップ"
+        exit 0
+    fi
+    if [[ $rc != 0 ]]; then
+        cat "$out" >&2
+        err "$REPLAY -c $3 が失敗 ($1)"
+        exit 1
+    fi
+    grep '^  icount ' "$out"
+}
+
+out=$(mktemp)
+trap 'rm -f "$out"' EXIT
+
+echo "base: $base_dir"
+echo "new:  $new_dir"
+echo "tolerance: +$tolerance%"
+fail=0
+for conf in "${confs[@]}"; do
+    for trace in "${traces[@]}"; do
+        base=$(run "$base_dir" "$conf" "$trace") || exit $?
+        new=$(run "$new_dir" "$conf" "$trace") || exit $?
+        # icount GETTER N events I insns/event B branches/event (METHOD)
+        paste -d'\n' <(echo "$base") <(echo "$new") |
+            awk -v conf="$(basename "$conf")" -v trace="$(basename "$trace" .trace)" \
+                -v tol="$tolerance" '
+            function check(what, b, n,   pct, mark) {
+                if (b == "-" || n == "-")
+                    return
+                pct = b > 0 ? (n - b) * 100 / b : 0
+                mark = pct > tol ? "  <-- regression" : ""
+                if (pct > tol)
+                    bad = 1
+                printf "  %-20s %-11s %-18s %-8s %7.1f -> %7.1f  %+6.2f%%%s\n",
+                       conf, trace, getter, what, b, n, pct, mark
+            }
+            NR % 2 == 1 { getter = $2; bi = $5; bb = $7; next }
+            {
+                if ($2 != getter) {
+                    print "getter mismatch: " getter " / " $2
+                    bad = 1
+                    next
+                }
+                check("insns", bi, $5)
+                check("branches", bb, $7)
+            }
+            END { exit bad }' || fail=1
+    done
+done
+
+echo ""
+if [[ $fail == 0 ]]; then
+    ok "命令数の退行なし（許容 +$tolerance%）"
+else
+    err "命令数が許容 +$tolerance% を超えて増加"
+fi
+exit $fail
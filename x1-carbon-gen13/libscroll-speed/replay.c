@@ -0,0 +1,827 @@
+/*
+ * replay.c — Replay harness feeding scroll traces into libscroll-speed
+ *
+ * Builds synthetic events with libinput-stub.so and calls the getters
+ * of an LD_PRELOADed libscroll-speed.so in the trace's order and with
+ * its timestamps.  Records the accumulated output (= the content's
+ * scroll position), so a run can be compared with a reference one for
+ * the finger-to-content error.
+ *
+ * Trace format (one axis per line, # starts a comment):
+ *   <time_usec> <finger|wheel|continuous> <v|h> <value>
+ *   device <vvvv:pppp> <width_mm> <height_mm> <name>
+ *     switches the device of the events that follow (size 0 = no
+ *     resolution known)
+ *   Session logs written by session-log=DIR (*.sslog,
+ *   scroll-speed-log.h) can be given as TRACE as they are (told apart
+ *   by their magic).
+ *
+ * Usage:
+ *   LD_PRELOAD=./libscroll-speed.so ./scroll-replay [options] TRACE
+ *     -d FILE   write the accumulated position as "time_usec pos_v pos_h"
+ *     -r FILE   compare with a reference position written by -d
+ *     -l MS     display latency assumed by the comparison (default 16)
+ *     -b N      replay N more times and time the events
+ *               (each pass shifted in time; used by make pgo to train
+ *               and measure)
+ *     -c        count instructions and branches per event and getter
+ *               (icount.h; used by make perf-gate; exit code 77 if
+ *               the counters are not available)
+ *     -q        read like Mutter: libinput_dispatch, libinput_get_event,
+ *               then the getters (for dequeue-transform=1)
+ *     -z        replay once more after the run (warmed up) and count
+ *               heap operations and system calls inside the getters;
+ *               exit code 1 if there is any (hotpath.h; used by make
+ *               hotpath; 77 without seccomp)
+ *     -a EXE,…  focus windows of executables by those names (fake
+ *               windows of libmutter-stub.so, stub-mutter.h) and also
+ *               print events and the |out| sum per app (for
+ *               app-scroll-factor and chrome-scroll-factor; used by
+ *               make per-app)
+ *     -A N      move the focus to the next -a window every N focus
+ *               lookups (default 0 = stay on the first; 1 switches on
+ *               every lookup, for -b and -c to measure switching)
+ *     -m OUT[@S],…  fake monitors with connector OUT and scale S
+ *               (default 1, stub-mutter.h), the pointer on the first;
+ *               one turn of the main loop (the engine's monitor check)
+ *               before each event, and events and the |out| sum per
+ *               monitor printed too (for monitor-scroll-factor; used by
+ *               make per-monitor)
+ *     -M N      move the pointer to the next -m monitor every N events
+ *               (default 0 = stay on the first)
+ *
+ *   finger-to-content error = |this run's position(t)
+ *                              - the reference's position(t + latency)|
+ *   Make the reference with prediction off, then compare prediction
+ *   off and on against it: the difference is the latency prediction
+ *   hid.  Each gesture (split at a stop event or a gap over 100 ms)
+ *   re-anchors on the reference.  The lead left over at a lift is
+ *   reported apart from the tracking error, as the lift residual.
+ *
+ *   The mean velocity of the last 3 deltas before a stop event
+ *   (output units/ms) is reported as the stop velocity: the client's
+ *   kinetic scroll starts from it.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hotpath.h"
+#include "icount.h"
+#include "scroll-speed-log.h"
+#include "stub-libinput.h"
+#include "stub-mutter.h"
+
+#define GESTURE_GAP_USEC 100000
+#define STOP_WINDOW      3
+#define COUNT_PASSES     2
+#define EXIT_SKIP        77
+
+struct sample {
+    uint64_t time;
+    double   pos[2];
+    int      begin;   /* first event of a gesture */
+};
+
+struct track {
+    struct sample *s;
+    size_t n, cap;
+};
+
+static void track_push(struct track *tr, uint64_t time, const double pos[2],
+                       int begin)
+{
+    if (tr->n == tr->cap) {
+        tr->cap = tr->cap ? tr->cap * 2 : 1024;
+        tr->s = realloc(tr->s, tr->cap * sizeof(*tr->s));
+        if (!tr->s) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    tr->s[tr->n].time = time;
+    tr->s[tr->n].pos[0] = pos[0];
+    tr->s[tr->n].pos[1] = pos[1];
+    tr->s[tr->n].begin = begin;
+    tr->n++;
+}
+
+static int parse_source(const char *s, enum libinput_event_type *type)
+{
+    if (strcmp(s, "finger") == 0)
+        *type = LIBINPUT_EVENT_POINTER_SCROLL_FINGER;
+    else if (strcmp(s, "wheel") == 0)
+        *type = LIBINPUT_EVENT_POINTER_SCROLL_WHEEL;
+    else if (strcmp(s, "continuous") == 0)
+        *type = LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS;
+    else
+        return -1;
+    return 0;
+}
+
+/* ── Replay ───────────────────────────────────────────────── */
+
+struct stop_stats {
+    int    count;
+    double sum, max;
+    double peak_sum, peak_max;   /* fastest window of each gesture */
+};
+
+/* Last STOP_WINDOW + 1 deltas per axis, newest at [0], and the
+ * fastest STOP_WINDOW-delta velocity of the gesture so far. */
+struct axis_tail {
+    uint64_t time[STOP_WINDOW + 1];
+    double   d[STOP_WINDOW + 1];
+    int      n;
+    double   peak;
+};
+
+/* Mean velocity (units/ms) over the last STOP_WINDOW deltas, or -1
+ * while the tail is short or the window has no duration. */
+static double tail_velocity(const struct axis_tail *tl)
+{
+    if (tl->n < STOP_WINDOW + 1 || tl->time[0] <= tl->time[STOP_WINDOW])
+        return -1.0;
+    double sum = 0.0;
+    for (int i = 0; i < STOP_WINDOW; i++)
+        sum += tl->d[i];
+    return fabs(sum) / ((double)(tl->time[0] - tl->time[STOP_WINDOW])
+                        / 1000.0);
+}
+
+static void tail_push(struct axis_tail *tl, uint64_t t, double d)
+{
+    memmove(&tl->time[1], &tl->time[0], STOP_WINDOW * sizeof(tl->time[0]));
+    memmove(&tl->d[1], &tl->d[0], STOP_WINDOW * sizeof(tl->d[0]));
+    tl->time[0] = t;
+    tl->d[0] = d;
+    if (tl->n < STOP_WINDOW + 1)
+        tl->n++;
+    double v = tail_velocity(tl);
+    if (v > tl->peak)
+        tl->peak = v;
+}
+
+static void tail_stop(struct axis_tail *tl, struct stop_stats *st)
+{
+    double v = tail_velocity(tl);
+    if (v >= 0.0) {
+        st->count++;
+        st->sum += v;
+        if (v > st->max)
+            st->max = v;
+        st->peak_sum += tl->peak;
+        if (tl->peak > st->peak_max)
+            st->peak_max = tl->peak;
+    }
+    tl->n = 0;
+    tl->peak = 0.0;
+}
+
+/* ── Trace loading ────────────────────────────────────────── */
+
+struct event {
+    uint64_t                  time;
+    struct libinput_device   *device;
+    enum libinput_event_type  type;
+    enum libinput_pointer_axis axis;
+    double                    value;
+};
+
+struct trace {
+    struct event *ev;
+    size_t n, cap;
+};
+
+static void trace_push(struct trace *tr, const struct event *e)
+{
+    if (tr->n == tr->cap) {
+        tr->cap = tr->cap ? tr->cap * 2 : 256;
+        tr->ev = realloc(tr->ev, tr->cap * sizeof(*tr->ev));
+        if (!tr->ev) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    tr->ev[tr->n++] = *e;
+}
+
+/* A session log, streamed: one stub device per distinct device */
+static int load_log(const char *path, struct trace *tr)
+{
+    static const enum libinput_event_type type[] = {
+        [SS_LOG_FINGER]     = LIBINPUT_EVENT_POINTER_SCROLL_FINGER,
+        [SS_LOG_WHEEL]      = LIBINPUT_EVENT_POINTER_SCROLL_WHEEL,
+        [SS_LOG_CONTINUOUS] = LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS,
+    };
+    struct ss_log_reader r;
+    if (ss_log_reader_open(&r, path) < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct ss_log_device seen[STUB_MAX_DEVICES];
+    struct libinput_device *made[STUB_MAX_DEVICES];
+    int nseen = 0;
+    struct libinput_device *device = NULL;
+    struct ss_log_event e;
+    int rc;
+    while ((rc = ss_log_next(&r, &e)) > 0) {
+        if (rc == SS_LOG_DEVICE) {
+            int i = 0;
+            while (i < nseen && !(seen[i].vendor == r.device.vendor &&
+                                  seen[i].product == r.device.product &&
+                                  seen[i].width == r.device.width &&
+                                  seen[i].height == r.device.height &&
+                                  !strcmp(seen[i].name, r.device.name)))
+                i++;
+            if (i == nseen) {
+                made[i] = stub_device_new(r.device.name, r.device.vendor,
+                                          r.device.product, r.device.width,
+                                          r.device.height);
+                if (!made[i]) {
+                    fprintf(stderr, "%s: too many devices\n", path);
+                    ss_log_reader_close(&r);
+                    return -1;
+                }
+                seen[nseen++] = r.device;
+            }
+            device = made[i];
+            continue;
+        }
+        trace_push(tr, &(struct event){
+            .time = e.time_usec, .device = device, .type = type[e.source],
+            .value = e.value,
+            .axis = e.axis ? LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL
+                           : LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL,
+        });
+    }
+    if (rc < 0)
+        fprintf(stderr, "%s: corrupt after %zu events\n", path, tr->n);
+    if (r.dropped)
+        fprintf(stderr, "%s: %llu events were dropped while logging\n",
+                path, (unsigned long long)r.dropped);
+    ss_log_reader_close(&r);
+    return rc < 0 ? -1 : 0;
+}
+
+static int load_trace(const char *path, struct trace *tr)
+{
+    if (ss_log_is_log(path))
+        return load_log(path, tr);
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    struct libinput_device *device = NULL;
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+
+        unsigned int vendor, product;
+        double w, h;
+        char name[64];
+        if (sscanf(line, " device %4x:%4x %lf %lf %63[^\n]",
+                   &vendor, &product, &w, &h, name) == 5) {
+            device = stub_device_new(name, vendor, product, w, h);
+            if (!device) {
+                fprintf(stderr, "%s:%d: too many devices\n", path, lineno);
+                fclose(f);
+                return -1;
+            }
+            continue;
+        }
+
+        unsigned long long t;
+        char src[16], ax[4];
+        double value;
+        int n = sscanf(line, "%llu %15s %3s %lf", &t, src, ax, &value);
+        if (n <= 0)
+            continue;
+
+        enum libinput_event_type type;
+        if (n != 4 || parse_source(src, &type) < 0 ||
+            (ax[0] != 'v' && ax[0] != 'h')) {
+            fprintf(stderr, "%s:%d: malformed line\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+
+        trace_push(tr, &(struct event){
+            .time = t, .device = device, .type = type, .value = value,
+            .axis = (ax[0] == 'v') ? LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL
+                                   : LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL,
+        });
+    }
+    fclose(f);
+    return 0;
+}
+
+/* ── Replay ───────────────────────────────────────────────── */
+
+/* Mutter reads v120 for wheels and the plain value otherwise */
+static int g_dequeue;   /* -q */
+
+/* The value Mutter would read.  With -q, the way Mutter reads it:
+ * dispatch, dequeue, getter, then dequeue again to find the queue
+ * empty (dequeue-transform does its work in the first two).        */
+static double read_event(struct libinput_event_pointer *ev,
+                         const struct event *e)
+{
+    if (g_dequeue) {
+        libinput_dispatch(NULL);
+        libinput_get_event(NULL);
+    }
+    double v = (e->type == LIBINPUT_EVENT_POINTER_SCROLL_WHEEL)
+        ? libinput_event_pointer_get_scroll_value_v120(ev, e->axis) / 8.0
+        : libinput_event_pointer_get_scroll_value(ev, e->axis);
+    if (g_dequeue)
+        libinput_get_event(NULL);
+    return v;
+}
+
+/* -a: the fake apps' windows, and what was delivered while each one
+ * had the focus                                                 */
+struct app {
+    const char   *exe;
+    int           window;
+    unsigned long events;
+    double        abs_sum;
+};
+static struct app g_apps[STUB_MAX_WINDOWS];
+static int g_napps;
+
+static int apps_start(char *list, unsigned every)
+{
+    int seq[STUB_MAX_WINDOWS];
+    for (char *exe = strtok(list, ","); exe; exe = strtok(NULL, ",")) {
+        if (g_napps == STUB_MAX_WINDOWS) {
+            fprintf(stderr, "-a: at most %d apps\n", STUB_MAX_WINDOWS);
+            return -1;
+        }
+        struct app *a = &g_apps[g_napps];
+        a->exe = exe;
+        a->window = stub_window_new(exe);
+        if (a->window < 0) {
+            fprintf(stderr, "-a %s: %s\n", exe, strerror(errno));
+            return -1;
+        }
+        seq[g_napps++] = a->window;
+    }
+    if (every)
+        stub_focus_script(seq, g_napps, every);
+    else if (g_napps)
+        stub_focus(seq[0]);
+    return 0;
+}
+
+static void apps_account(double d)
+{
+    int w = stub_focused();
+    for (int i = 0; i < g_napps; i++) {
+        if (g_apps[i].window == w) {
+            g_apps[i].events++;
+            g_apps[i].abs_sum += fabs(d);
+            return;
+        }
+    }
+}
+
+/* -m: the fake monitors, and what was delivered while the pointer
+ * was on each one                                              */
+struct monitor {
+    const char   *name;     /* as given, without the scale */
+    int           index;
+    unsigned long events;
+    double        abs_sum;
+};
+static struct monitor g_monitors[STUB_MAX_MONITORS];
+static int g_nmonitors;
+static unsigned g_monitor_every;
+static unsigned long g_monitor_steps;
+
+static int monitors_start(char *list, unsigned every)
+{
+    for (char *out = strtok(list, ","); out; out = strtok(NULL, ",")) {
+        if (g_nmonitors == STUB_MAX_MONITORS) {
+            fprintf(stderr, "-m: at most %d monitors\n", STUB_MAX_MONITORS);
+            return -1;
+        }
+        char *at = strchr(out, '@');
+        float scale = 1.0f;
+        if (at) {
+            *at = '\0';
+            scale = strtof(at + 1, NULL);
+        }
+        struct monitor *m = &g_monitors[g_nmonitors++];
+        m->name = out;
+        m->index = stub_monitor_new(out, scale);
+        if (m->index < 0) {
+            fprintf(stderr, "-m %s: %s\n", out, strerror(errno));
+            return -1;
+        }
+    }
+    if (!g_nmonitors)
+        return 0;
+    stub_pointer_to(g_monitors[0].index);
+    g_monitor_every = every;
+
+    /* The engine thread starts with the first getter call and adds
+     * its main-thread check once it sees the rules; a scroll stop
+     * leaves no per-gesture state behind.                        */
+    libinput_event_pointer_get_scroll_value(
+        stub_pointer_event(NULL, LIBINPUT_EVENT_POINTER_SCROLL_FINGER, 0,
+                           LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL, 0.0),
+        LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL);
+    for (int ms = 0; !stub_main_sources() && ms < 2000; ms++) {
+        struct timespec ts = { 0, 1000000 };
+        nanosleep(&ts, NULL);
+    }
+    if (!stub_main_sources())
+        fprintf(stderr, "-m: the engine does not check monitors "
+                "(no monitor-scroll-factor?)\n");
+    return 0;
+}
+
+/* Before each event: move the pointer every -M events, then one
+ * turn of the main loop, as if the pointer had been there for
+ * longer than the engine's check interval                      */
+static void monitors_step(void)
+{
+    if (!g_nmonitors)
+        return;
+    unsigned long n = g_monitor_steps++;
+    if (g_monitor_every && n && n % g_monitor_every == 0)
+        stub_pointer_to(g_monitors[n / g_monitor_every % g_nmonitors].index);
+    stub_main_iterate();
+}
+
+static void monitors_account(double d)
+{
+    int p = stub_pointer_monitor();
+    for (int i = 0; i < g_nmonitors; i++) {
+        if (g_monitors[i].index == p) {
+            g_monitors[i].events++;
+            g_monitors[i].abs_sum += fabs(d);
+            return;
+        }
+    }
+}
+
+static double deliver(const struct event *e, uint64_t time)
+{
+    return read_event(stub_pointer_event(e->device, e->type, time,
+                                         e->axis, e->value), e);
+}
+
+static void replay(const struct trace *tr, struct track *out,
+                   double *abs_sum, struct stop_stats *stops)
+{
+    double pos[2] = {0.0, 0.0};
+    int stopped = 1;
+    uint64_t last_t = 0;
+    struct axis_tail tail[2];
+    memset(tail, 0, sizeof(tail));
+    for (size_t i = 0; i < tr->n; i++) {
+        const struct event *e = &tr->ev[i];
+        monitors_step();
+        double d = deliver(e, e->time);
+
+        int begin = stopped || e->time - last_t > GESTURE_GAP_USEC;
+        stopped = (e->value == 0.0);
+        last_t = e->time;
+
+        if (e->value == 0.0)
+            tail_stop(&tail[e->axis & 1], stops);
+        else
+            tail_push(&tail[e->axis & 1], e->time, d);
+
+        pos[e->axis & 1] += d;
+        *abs_sum += fabs(d);
+        apps_account(d);
+        monitors_account(d);
+        track_push(out, e->time, pos, begin);
+    }
+}
+
+/* Replay the trace `passes` more times, each shifted to start a
+ * second after the previous one ended, and time the getter calls
+ * as a whole (the stub's event setup is included, but it is the
+ * same few stores for every build).                              */
+static void bench(const struct trace *tr, int passes)
+{
+    if (!tr->n)
+        return;
+    uint64_t span = tr->ev[tr->n - 1].time - tr->ev[0].time + 1000000;
+    volatile double sink = 0.0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int p = 1; p <= passes; p++) {
+        uint64_t shift = (uint64_t)p * span;
+        for (size_t i = 0; i < tr->n; i++)
+            sink += deliver(&tr->ev[i], tr->ev[i].time + shift);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    (void)sink;
+    double ns = (double)(t1.tv_sec - t0.tv_sec) * 1e9 +
+                (double)(t1.tv_nsec - t0.tv_nsec);
+    printf("  bench: %d passes x %zu events, %.1f ns/event\n",
+           passes, tr->n, ns / ((double)passes * (double)tr->n));
+}
+
+/* Instructions (and branches) per getter call, over COUNT_PASSES
+ * shifted passes keeping each event's minimum: one-off work that
+ * lands on some event in one pass (a config published by the engine
+ * thread being installed) does not land on the same event in the
+ * other.  Only the getter call (with -q, also the dispatch and
+ * dequeue calls) is inside the counted region.                    */
+static void count(const struct trace *tr, enum icount_method method)
+{
+    if (!tr->n)
+        return;
+    uint64_t (*min)[2] = malloc(tr->n * sizeof(*min));
+    if (!min) {
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < tr->n; i++)
+        min[i][0] = min[i][1] = UINT64_MAX;
+
+    uint64_t span = tr->ev[tr->n - 1].time - tr->ev[0].time + 1000000;
+    volatile double sink = 0.0;
+    for (int p = 1; p <= COUNT_PASSES; p++) {
+        for (size_t i = 0; i < tr->n; i++) {
+            const struct event *e = &tr->ev[i];
+            struct libinput_event_pointer *ev = stub_pointer_event(
+                e->device, e->type, e->time + (uint64_t)p * span,
+                e->axis, e->value);
+            uint64_t c[2];
+            icount_begin();
+            sink += read_event(ev, e);
+            icount_end(&c[0], &c[1]);
+            for (int k = 0; k < 2; k++)
+                if (c[k] < min[i][k])
+                    min[i][k] = c[k];
+        }
+    }
+    (void)sink;
+
+    /* [getter][insns, branches, events] */
+    double sum[2][3] = { { 0 } };
+    int have_branches = 1;
+    for (size_t i = 0; i < tr->n; i++) {
+        int g = tr->ev[i].type == LIBINPUT_EVENT_POINTER_SCROLL_WHEEL;
+        sum[g][0] += (double)min[i][0];
+        sum[g][1] += (double)min[i][1];
+        sum[g][2] += 1.0;
+        if (min[i][1] == UINT64_MAX)
+            have_branches = 0;
+    }
+    static const char *const getter[2] = { "scroll_value", "scroll_value_v120" };
+    for (int g = 0; g < 2; g++) {
+        if (!sum[g][2])
+            continue;
+        printf("  icount %-17s %4.0f events  %7.1f insns/event", getter[g],
+               sum[g][2], sum[g][0] / sum[g][2]);
+        if (have_branches)
+            printf("  %6.1f branches/event", sum[g][1] / sum[g][2]);
+        else
+            printf("  %6s branches/event", "-");
+        printf("  (%s)\n", icount_method_name(method));
+    }
+    free(min);
+}
+
+/* One more pass, a second after the replay, with every heap
+ * operation and system call counted (hotpath.h).  The replay has
+ * already seen every device and gesture shape in the trace, so this
+ * is the steady state; the stub's event setup is counted too and
+ * must stay clean.                                                 */
+static void steady_pass(void *arg)
+{
+    const struct trace *tr = arg;
+    uint64_t span = tr->ev[tr->n - 1].time - tr->ev[0].time + 1000000;
+    volatile double sink = 0.0;
+    for (size_t i = 0; i < tr->n; i++) {
+        hotpath_mark((long)i);
+        sink += deliver(&tr->ev[i], tr->ev[i].time + span);
+    }
+    (void)sink;
+}
+
+/* 0 = clean, 1 = violations, EXIT_SKIP = cannot check */
+static int hotpath(const struct trace *tr)
+{
+    if (!tr->n)
+        return 0;
+    struct hotpath_report r;
+    if (hotpath_run(steady_pass, (void *)tr, &r) < 0) {
+        fprintf(stderr, "hotpath: seccomp unavailable\n");
+        return EXIT_SKIP;
+    }
+    printf("  hotpath: %zu events, %llu heap ops, %llu syscalls", tr->n,
+           (unsigned long long)r.heap, (unsigned long long)r.syscalls);
+    if (r.heap)
+        printf("  (first: %s at event %ld)", r.first_heap, r.heap_at);
+    if (r.syscalls)
+        printf("  (first: %s [%ld] at event %ld)",
+               hotpath_syscall_name(r.first_syscall), r.first_syscall,
+               r.syscall_at);
+    printf("%s\n", r.heap || r.syscalls ? "  <-- not allowed" : "");
+    return r.heap || r.syscalls;
+}
+
+/* ── Position dump / reference ────────────────────────────── */
+
+static int dump_track(const char *path, const struct track *tr)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    for (size_t i = 0; i < tr->n; i++)
+        fprintf(f, "%llu %.6f %.6f\n", (unsigned long long)tr->s[i].time,
+                tr->s[i].pos[0], tr->s[i].pos[1]);
+    fclose(f);
+    return 0;
+}
+
+static int load_track(const char *path, struct track *tr)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    unsigned long long t;
+    double pos[2];
+    while (fscanf(f, "%llu %lf %lf", &t, &pos[0], &pos[1]) == 3)
+        track_push(tr, t, pos, 0);
+    fclose(f);
+    return 0;
+}
+
+/* Reference position at time t: last sample at or before t */
+static const double *ref_at(const struct track *ref, uint64_t t)
+{
+    static const double origin[2] = {0.0, 0.0};
+    size_t lo = 0, hi = ref->n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (ref->s[mid].time <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo ? ref->s[lo - 1].pos : origin;
+}
+
+static void report_error(const struct track *run, const struct track *ref,
+                         double latency_ms)
+{
+    uint64_t lat = (uint64_t)(latency_ms * 1000.0);
+    double sum = 0.0, max = 0.0;
+    double anchor[2] = {0.0, 0.0};
+    double lift_sum = 0.0;
+    int gestures = 0;
+    for (size_t i = 0; i < run->n; i++) {
+        const struct sample *s = &run->s[i];
+        if (s->begin) {
+            /* Offset left over from the previous gesture */
+            const double *before = ref_at(ref, s->time - 1);
+            const double *prev = i ? run->s[i - 1].pos : before;
+            double ov = prev[0] - before[0] - anchor[0];
+            double oh = prev[1] - before[1] - anchor[1];
+            if (i)
+                lift_sum += sqrt(ov * ov + oh * oh);
+            anchor[0] = prev[0] - before[0];
+            anchor[1] = prev[1] - before[1];
+            gestures++;
+        }
+        const double *ideal = ref_at(ref, s->time + lat);
+        double dv = s->pos[0] - anchor[0] - ideal[0];
+        double dh = s->pos[1] - anchor[1] - ideal[1];
+        double e = sqrt(dv * dv + dh * dh);
+        sum += e;
+        if (e > max)
+            max = e;
+    }
+    printf("  finger-to-content error @%.0fms: mean %.3f  max %.3f\n",
+           latency_ms, run->n ? sum / (double)run->n : 0.0, max);
+    printf("  residual at lift: mean %.3f over %d gestures\n",
+           gestures > 1 ? lift_sum / (double)(gestures - 1) : 0.0, gestures);
+}
+
+/* ── Main ─────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    const char *dump = NULL, *ref_path = NULL;
+    double latency_ms = 16.0;
+    int passes = 0, counting = 0, checking = 0;
+    char *apps = NULL, *monitors = NULL;
+    unsigned every = 0, monitor_every = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:r:l:b:cqza:A:m:M:")) != -1) {
+        switch (opt) {
+        case 'd': dump = optarg; break;
+        case 'r': ref_path = optarg; break;
+        case 'l': latency_ms = atof(optarg); break;
+        case 'b': passes = atoi(optarg); break;
+        case 'c': counting = 1; break;
+        case 'q': g_dequeue = 1; break;
+        case 'z': checking = 1; break;
+        case 'a': apps = optarg; break;
+        case 'A': every = (unsigned)atoi(optarg); break;
+        case 'm': monitors = optarg; break;
+        case 'M': monitor_every = (unsigned)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-d dump] [-r ref] [-l ms] [-b passes] "
+                    "[-c] [-q] [-z] [-a exe,... [-A n]] "
+                    "[-m out[@scale],... [-M n]] TRACE\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-d dump] [-r ref] [-l ms] [-b passes] "
+                "[-c] [-q] [-z] [-a exe,... [-A n]] "
+                "[-m out[@scale],... [-M n]] TRACE\n", argv[0]);
+        return 2;
+    }
+
+    /* Before the first getter call: the ptrace counter forks here */
+    enum icount_method method = ICOUNT_NONE;
+    if (counting && (method = icount_init()) == ICOUNT_NONE) {
+        fprintf(stderr, "%s: no instruction counter (perf_event_open "
+                "and ptrace both unavailable)\n", argv[0]);
+        return EXIT_SKIP;
+    }
+    /* In the process that replays (the counter's child) */
+    if (apps && apps_start(apps, every) < 0)
+        return 1;
+    if (monitors && monitors_start(monitors, monitor_every) < 0)
+        return 1;
+
+    const char *path = argv[optind];
+    struct trace tr = {0};
+    if (load_trace(path, &tr) < 0)
+        return 1;
+
+    struct track run = {0};
+    double abs_sum = 0.0;
+    struct stop_stats stops = {0};
+    replay(&tr, &run, &abs_sum, &stops);
+
+    printf("%s: %zu events, total |out| %.2f\n", path, run.n, abs_sum);
+    for (int i = 0; i < g_napps; i++)
+        printf("  app %s: %lu events, |out| %.2f\n", g_apps[i].exe,
+               g_apps[i].events, g_apps[i].abs_sum);
+    if (g_napps)
+        printf("  focus lookups %lu\n", stub_focus_lookups());
+    for (int i = 0; i < g_nmonitors; i++)
+        printf("  monitor %s: %lu events, |out| %.2f\n", g_monitors[i].name,
+               g_monitors[i].events, g_monitors[i].abs_sum);
+    if (stops.count) {
+        printf("  stop velocity: mean %.3f  max %.3f /ms over %d stops\n",
+               stops.sum / stops.count, stops.max, stops.count);
+        printf("  peak velocity: mean %.3f  max %.3f /ms\n",
+               stops.peak_sum / stops.count, stops.peak_max);
+    }
+
+    if (dump && dump_track(dump, &run) < 0)
+        return 1;
+
+    if (ref_path) {
+        struct track ref = {0};
+        if (load_track(ref_path, &ref) < 0)
+            return 1;
+        report_error(&run, &ref, latency_ms);
+        free(ref.s);
+    }
+
+    /* Straight after the replay: the later passes shift further */
+    int rc = 0;
+    if (checking)
+        rc = hotpath(&tr);
+
+    if (passes > 0)
+        bench(&tr, passes);
+    if (counting)
+        count(&tr, method);
+
+    free(run.s);
+    free(tr.ev);
+    return rc;
+}
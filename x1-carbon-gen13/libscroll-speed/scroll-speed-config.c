@@ -0,0 +1,885 @@
+/*
+ * scroll-speed-config.c — Text config parser, validation and image
+ * header for struct ss_config
+ *
+ * Linked into both libscroll-speed.so (fallback when no compiled
+ * image is present, control socket) and scroll-speed-ctl (compile
+ * step).
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scroll-speed-config.h"
+#include "scroll-speed-expr.h"
+
+/* ── Key table ────────────────────────────────────────────── */
+
+enum key_type  { KEY_DOUBLE, KEY_INT, KEY_BOOL, KEY_POINTS, KEY_EXPR,
+                 KEY_STRING };
+enum key_scope { SCOPE_GLOBAL, SCOPE_PROFILE };
+
+struct key_desc {
+    const char *key;
+    int         type;
+    int         scope;
+    size_t      offset;   /* into ss_config or ss_profile */
+    double      min, max; /* KEY_POINTS: for each coordinate;
+                             KEY_STRING: max = buffer size */
+};
+
+#define G(f) SCOPE_GLOBAL,  offsetof(struct ss_config, f)
+#define P(f) SCOPE_PROFILE, offsetof(struct ss_profile, f)
+
+static const struct key_desc keys[] = {
+    { "base-speed",               KEY_DOUBLE, P(finger.base_speed),        0.0, 100.0 },
+    { "scroll-cap",               KEY_DOUBLE, P(finger.scroll_cap),        0.0, 1000.0 },
+    { "ramp-softness",            KEY_DOUBLE, P(finger.ramp_softness),     0.1, 10.0 },
+    { "low-cut",                  KEY_DOUBLE, P(finger.low_cut),           0.0, 100.0 },
+    { "curve-points",             KEY_POINTS, P(finger.points),            0.0, 1000.0 },
+    { "curve-expr",               KEY_EXPR,   P(finger.expr),              0.0, 0.0 },
+    { "trackpoint-base-speed",    KEY_DOUBLE, P(trackpoint.base_speed),    0.0, 100.0 },
+    { "trackpoint-scroll-cap",    KEY_DOUBLE, P(trackpoint.scroll_cap),    0.0, 1000.0 },
+    { "trackpoint-ramp-softness", KEY_DOUBLE, P(trackpoint.ramp_softness), 0.1, 10.0 },
+    { "trackpoint-low-cut",       KEY_DOUBLE, P(trackpoint.low_cut),       0.0, 100.0 },
+    { "trackpoint-curve-points",  KEY_POINTS, P(trackpoint.points),        0.0, 1000.0 },
+    { "trackpoint-curve-expr",    KEY_EXPR,   P(trackpoint.expr),          0.0, 0.0 },
+    { "physical-units",           KEY_BOOL,   P(physical_units),           0.0, 1.0 },
+
+    { "discrete-scroll-factor",        KEY_DOUBLE, G(discrete_factor),         0.0, 100.0 },
+    { "chrome-scroll-factor",          KEY_DOUBLE, G(chrome_scroll_factor),    0.0, 100.0 },
+    { "trackpoint-velocity-model",     KEY_BOOL,   G(trackpoint_velocity),     0.0, 1.0 },
+    { "trackpoint-reference-interval", KEY_DOUBLE, G(trackpoint_ref_interval), 1.0, 1000.0 },
+    { "prediction-horizon",            KEY_DOUBLE, G(predict_horizon),         0.0, 100.0 },
+    { "prediction-damping",            KEY_DOUBLE, G(predict_damping),         0.0, 1.0 },
+    { "prediction-max",                KEY_DOUBLE, G(predict_max),             0.0, 100.0 },
+    { "stop-velocity-max",             KEY_DOUBLE, G(stop_velocity_max),       0.0, 100.0 },
+    { "stop-shaping-events",           KEY_INT,    G(stop_shaping_events),     1.0, SS_STOP_SHAPING_MAX },
+    { "wheel-accel-ramp",              KEY_DOUBLE, G(wheel_accel_ramp),        0.0, 100.0 },
+    { "wheel-accel-threshold",         KEY_DOUBLE, G(wheel_accel_threshold),   1.0, 10000.0 },
+    { "wheel-accel-max",               KEY_DOUBLE, G(wheel_accel_max),         1.0, 100.0 },
+    { "latency-stats",                 KEY_BOOL,   G(latency_stats),           0.0, 1.0 },
+    { "dequeue-transform",             KEY_BOOL,   G(dequeue_transform),       0.0, 1.0 },
+    { "latency-budget",                KEY_DOUBLE, G(latency_budget),          0.0, 1000000.0 },
+    { "latency-budget-overruns",       KEY_INT,    G(latency_budget_overruns), 1.0, 256.0 },
+    { "metrics-file",                  KEY_STRING, G(metrics_file),            0.0, SS_MAX_PATH },
+    { "metrics-interval",              KEY_INT,    G(metrics_interval),        1.0, 3600.0 },
+    { "event-tap",                     KEY_BOOL,   G(event_tap),               0.0, 1.0 },
+    { "session-log",                   KEY_STRING, G(session_log),             0.0, SS_MAX_PATH },
+    { "session-log-size",              KEY_INT,    G(session_log_size),        4.0, 1048576.0 },
+    { "session-log-files",             KEY_INT,    G(session_log_files),       1.0, 1000.0 },
+};
+
+#undef G
+#undef P
+
+#define NKEYS (sizeof(keys) / sizeof(keys[0]))
+
+static const struct key_desc *find_key(const char *key)
+{
+    for (size_t i = 0; i < NKEYS; i++)
+        if (strcmp(keys[i].key, key) == 0)
+            return &keys[i];
+    return NULL;
+}
+
+/* trackpoint_follows bits, in ss_curve field order */
+static const size_t follow_fields[] = {
+    offsetof(struct ss_profile, trackpoint.base_speed),
+    offsetof(struct ss_profile, trackpoint.scroll_cap),
+    offsetof(struct ss_profile, trackpoint.ramp_softness),
+    offsetof(struct ss_profile, trackpoint.low_cut),
+    offsetof(struct ss_profile, trackpoint.points),
+    offsetof(struct ss_profile, trackpoint.expr),
+};
+#define FOLLOW_SHAPE 0x30   /* points | expr */
+
+/* trackpoint_follows bit of a trackpoint-* key, or 0 for other keys */
+static uint32_t follow_bit(const struct key_desc *k)
+{
+    if (k->scope != SCOPE_PROFILE)
+        return 0;
+    for (size_t i = 0; i < sizeof(follow_fields) / sizeof(follow_fields[0]); i++)
+        if (k->offset == follow_fields[i])
+            return 1u << i;
+    return 0;
+}
+
+/* ── Defaults ─────────────────────────────────────────────── */
+
+void ss_config_defaults(struct ss_config *c)
+{
+    memset(c, 0, sizeof(*c));
+
+    c->discrete_factor = 1.0;
+    c->chrome_scroll_factor = 1.0;
+    c->trackpoint_velocity = 0;
+    c->trackpoint_ref_interval = 10.0;
+    c->predict_horizon = 0.0;
+    c->predict_damping = 0.5;
+    c->predict_max = 4.0;
+    c->stop_velocity_max = 0.0;
+    c->stop_shaping_events = 3;
+    c->wheel_accel_ramp = 0.0;
+    c->wheel_accel_threshold = 100.0;
+    c->wheel_accel_max = 4.0;
+    c->latency_stats = 0;
+    c->dequeue_transform = 0;
+    c->latency_budget = 0.0;
+    c->latency_budget_overruns = 8;
+    c->metrics_interval = 15;
+    c->event_tap = 0;
+    c->session_log_size = 512;
+    c->session_log_files = 8;
+    c->forced_profile = -1;
+
+    struct ss_profile *p = &c->profiles[0];
+    c->nprofiles = 1;
+    strcpy(p->name, "default");
+    p->finger.base_speed = 0.46;
+    p->finger.scroll_cap = 20.0;
+    p->finger.ramp_softness = 1.0;
+    p->finger.low_cut = 0.0;
+
+    /* all six follow the touchpad curve until set (resolved in finish) */
+    p->trackpoint_follows = 0x3f;
+}
+
+/* ── Text parser ──────────────────────────────────────────── */
+
+static void trim(char *s)
+{
+    char *end = s + strlen(s) - 1;
+    while (end >= s && (*end == ' ' || *end == '\t' || *end == '\n' || *end == '\r'))
+        *end-- = '\0';
+    char *start = s;
+    while (*start == ' ' || *start == '\t')
+        start++;
+    if (start != s)
+        memmove(s, start, strlen(start) + 1);
+}
+
+static void reportf(ss_report_fn report, void *ctx, int line,
+                    const char *fmt, ...)
+{
+    if (!report)
+        return;
+    char msg[160];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    report(ctx, line, msg);
+}
+
+static int parse_number(const char *val, double *out)
+{
+    char *end;
+    *out = strtod(val, &end);
+    return end != val && *end == '\0' && isfinite(*out);
+}
+
+/* curve-points=<delta>:<output> ..., separated by spaces or commas.
+ * Deltas strictly increasing, outputs non-decreasing; the curve
+ * starts at 0:0, which is prepended when missing.  An empty value
+ * goes back to the formula.                                      */
+static int parse_points(struct ss_points *pts, char *val,
+                        const struct key_desc *k,
+                        char *err, size_t errlen)
+{
+    struct ss_points out;
+    memset(&out, 0, sizeof(out));
+
+    for (char *save = NULL, *tok = strtok_r(val, " ,\t", &save); tok;
+         tok = strtok_r(NULL, " ,\t", &save)) {
+        char *colon = strchr(tok, ':');
+        double x, y;
+        if (!colon) {
+            snprintf(err, errlen, "'%s': expected <delta>:<output>", tok);
+            return 0;
+        }
+        *colon = '\0';
+        if (!parse_number(tok, &x) || !parse_number(colon + 1, &y) ||
+            x < k->min || x > k->max || y < k->min || y > k->max) {
+            snprintf(err, errlen, "bad point '%s:%s'", tok, colon + 1);
+            return 0;
+        }
+        if (out.n == 0 && x > 0.0) {
+            out.n = 1;            /* implicit 0:0 */
+        }
+        if (out.n == SS_MAX_CURVE_POINTS) {
+            snprintf(err, errlen, "too many points (max %d including 0:0)",
+                     SS_MAX_CURVE_POINTS);
+            return 0;
+        }
+        if (out.n > 0 && (x <= out.x[out.n - 1] || y < out.y[out.n - 1])) {
+            snprintf(err, errlen, "point %g:%g: deltas must increase and "
+                     "outputs must not decrease", x, y);
+            return 0;
+        }
+        out.x[out.n] = x;
+        out.y[out.n] = y;
+        out.n++;
+    }
+    if (out.n == 1) {
+        snprintf(err, errlen, "need at least one point besides 0:0");
+        return 0;
+    }
+    *pts = out;
+    return 1;
+}
+
+/* app-scroll-factor=<exe path substring> <factor> */
+static int parse_app_rule(struct ss_config *c, char *val)
+{
+    char *sp = strrchr(val, ' ');
+    if (!sp || c->napp_rules == SS_MAX_APP_RULES)
+        return 0;
+    *sp = '\0';
+    trim(val);
+
+    double factor;
+    if (!*val || strlen(val) >= sizeof(c->app_rules[0].pattern) ||
+        !parse_number(sp + 1, &factor) || factor < 0.0 || factor > 100.0)
+        return 0;
+
+    struct ss_app_rule *r = &c->app_rules[c->napp_rules++];
+    snprintf(r->pattern, sizeof(r->pattern), "%s", val);
+    r->factor = factor;
+    return 1;
+}
+
+/* EDID key: PNP manufacturer ID and product code, "LEN:40a9" */
+static int is_edid_key(const char *s)
+{
+    if (strlen(s) != 8 || s[3] != ':')
+        return 0;
+    for (int i = 0; i < 8; i++)
+        if (i < 3 ? !isalpha((unsigned char)s[i])
+                  : i > 3 && !isxdigit((unsigned char)s[i]))
+            return 0;
+    return 1;
+}
+
+/* monitor-scroll-factor=<connector or MFG:pppp>[@<scale>] <factor> */
+static int parse_monitor_rule(struct ss_config *c, char *val)
+{
+    char *sp = strrchr(val, ' ');
+    if (!sp || c->nmonitor_rules == SS_MAX_MONITOR_RULES)
+        return 0;
+    *sp = '\0';
+    trim(val);
+
+    double scale = 0.0, factor;
+    char *at = strchr(val, '@');
+    if (at) {
+        *at = '\0';
+        if (!parse_number(at + 1, &scale) || scale < 0.5 || scale > 8.0)
+            return 0;
+    }
+    if (!*val || strlen(val) >= sizeof(c->monitor_rules[0].output) ||
+        strpbrk(val, " \t/") || (strchr(val, ':') && !is_edid_key(val)) ||
+        !parse_number(sp + 1, &factor) || factor < 0.0 || factor > 100.0)
+        return 0;
+
+    struct ss_monitor_rule *r = &c->monitor_rules[c->nmonitor_rules++];
+    snprintf(r->output, sizeof(r->output), "%s", val);
+    r->scale = scale;
+    r->factor = factor;
+    return 1;
+}
+
+static int set_key(struct ss_config *c, struct ss_profile *p,
+                   const char *key, char *val, int lineno,
+                   ss_report_fn report, void *ctx)
+{
+    if (strcmp(key, "match") == 0) {
+        if (p == &c->profiles[0] || strlen(val) >= sizeof(p->match)) {
+            reportf(report, ctx, lineno,
+                    "match= needs a [profile] section and < 64 chars");
+            return 0;
+        }
+        snprintf(p->match, sizeof(p->match), "%s", val);
+        return 1;
+    }
+    if (strcmp(key, "app-scroll-factor") == 0) {
+        if (!parse_app_rule(c, val)) {
+            reportf(report, ctx, lineno,
+                    "app-scroll-factor: expected '<exe substring> <factor>'"
+                    " (max %d rules)", SS_MAX_APP_RULES);
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(key, "monitor-scroll-factor") == 0) {
+        if (!parse_monitor_rule(c, val)) {
+            reportf(report, ctx, lineno,
+                    "monitor-scroll-factor: expected '<connector or "
+                    "MFG:pppp>[@scale] <factor>' (max %d rules)",
+                    SS_MAX_MONITOR_RULES);
+            return 0;
+        }
+        return 1;
+    }
+
+    const struct key_desc *k = find_key(key);
+    if (!k) {
+        reportf(report, ctx, lineno, "unknown key '%s'", key);
+        return 0;
+    }
+
+    /* curve-points / curve-expr: setting either one replaces the
+     * curve's shape, so it clears the other (and stops following). */
+    if (k->type == KEY_POINTS || k->type == KEY_EXPR) {
+        struct ss_curve *curve = (struct ss_curve *)((char *)p + k->offset -
+            (k->type == KEY_POINTS ? offsetof(struct ss_curve, points)
+                                   : offsetof(struct ss_curve, expr)));
+        char err[120];
+        struct ss_expr_prog prog;
+        static const double unbound[SS_EXPR_NVARS] = {
+            NAN, NAN, NAN, NAN, NAN, NAN
+        };
+
+        if (k->type == KEY_POINTS) {
+            if (!parse_points(&curve->points, val, k, err, sizeof(err))) {
+                reportf(report, ctx, lineno, "%s: %s", key, err);
+                return 0;
+            }
+            curve->expr[0] = '\0';
+        } else {
+            if (strlen(val) >= sizeof(curve->expr) ||
+                (*val && ss_expr_compile(val, unbound, &prog,
+                                         err, sizeof(err)) < 0)) {
+                if (*val && strlen(val) >= sizeof(curve->expr))
+                    snprintf(err, sizeof(err), "longer than %d chars",
+                             SS_MAX_CURVE_EXPR - 1);
+                reportf(report, ctx, lineno, "%s: %s", key, err);
+                return 0;
+            }
+            snprintf(curve->expr, sizeof(curve->expr), "%s", val);
+            curve->points.n = 0;
+        }
+        if (curve == &p->trackpoint)
+            p->trackpoint_follows &= ~FOLLOW_SHAPE;
+        return 1;
+    }
+
+    char *base = (k->scope == SCOPE_PROFILE) ? (char *)p : (char *)c;
+    if (k->type == KEY_STRING) {
+        if (strlen(val) >= (size_t)k->max) {
+            reportf(report, ctx, lineno, "%s: longer than %d chars",
+                    key, (int)k->max - 1);
+            return 0;
+        }
+        snprintf(base + k->offset, (size_t)k->max, "%s", val);
+        return 1;
+    }
+
+    double v;
+    if (!parse_number(val, &v)) {
+        reportf(report, ctx, lineno, "'%s' is not a number", val);
+        return 0;
+    }
+    if (v < k->min || v > k->max ||
+        (k->type != KEY_DOUBLE && v != floor(v))) {
+        reportf(report, ctx, lineno, "%s out of range", key);
+        return 0;
+    }
+
+    if (k->type == KEY_DOUBLE)
+        *(double *)(base + k->offset) = v;
+    else
+        *(int32_t *)(base + k->offset) = (int32_t)v;
+    p->trackpoint_follows &= ~follow_bit(k);
+    return 1;
+}
+
+int ss_config_parse(struct ss_config *c, FILE *f,
+                    ss_report_fn report, void *ctx)
+{
+    struct ss_profile *p = &c->profiles[0];
+    int errors = 0;
+    int lineno = 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        trim(line);
+        if (line[0] == '\0')
+            continue;
+
+        /* [profile NAME] starts from the default profile's values
+         * at this point; keys of an unusable section are skipped. */
+        if (line[0] == '[') {
+            char name[32];
+            size_t len = strlen(line);
+            if (line[len - 1] != ']' ||
+                sscanf(line, "[profile %31[^]]]", name) != 1) {
+                reportf(report, ctx, lineno, "bad section '%s'", line);
+                errors++;
+                p = NULL;
+                continue;
+            }
+            if (c->nprofiles == SS_MAX_PROFILES) {
+                reportf(report, ctx, lineno,
+                        "too many profiles (max %d)", SS_MAX_PROFILES);
+                errors++;
+                p = NULL;
+                continue;
+            }
+            p = &c->profiles[c->nprofiles++];
+            *p = c->profiles[0];
+            trim(name);
+            snprintf(p->name, sizeof(p->name), "%s", name);
+            p->match[0] = '\0';
+            continue;
+        }
+        if (!p)
+            continue;
+
+        char *eq = strchr(line, '=');
+        if (!eq) {
+            reportf(report, ctx, lineno, "expected key=value: '%s'", line);
+            errors++;
+            continue;
+        }
+
+        *eq = '\0';
+        char *key = line;
+        char *val = eq + 1;
+        trim(key);
+        trim(val);
+
+        if (!set_key(c, p, key, val, lineno, report, ctx))
+            errors++;
+    }
+
+    return errors;
+}
+
+/* ── Curves ───────────────────────────────────────────────── */
+
+/*
+ * Fritsch–Carlson: secant slopes, averaged into tangents (zero at
+ * flat segments and local extrema), then scaled down wherever
+ * (α² + β²) > 9 so each Hermite segment stays monotone.
+ */
+static void points_fit(struct ss_points *p)
+{
+    double d[SS_MAX_CURVE_POINTS];
+    int n = p->n;
+    if (n < 2)
+        return;
+
+    for (int i = 0; i < n - 1; i++)
+        d[i] = (p->y[i + 1] - p->y[i]) / (p->x[i + 1] - p->x[i]);
+
+    p->m[0] = d[0];
+    p->m[n - 1] = d[n - 2];
+    for (int i = 1; i < n - 1; i++)
+        p->m[i] = (d[i - 1] == 0.0 || d[i] == 0.0)
+            ? 0.0 : (d[i - 1] + d[i]) / 2.0;
+
+    for (int i = 0; i < n - 1; i++) {
+        if (d[i] == 0.0) {
+            p->m[i] = p->m[i + 1] = 0.0;
+            continue;
+        }
+        double a = p->m[i] / d[i];
+        double b = p->m[i + 1] / d[i];
+        double s = a * a + b * b;
+        if (s > 9.0) {
+            double t = 3.0 / sqrt(s);
+            p->m[i] = t * a * d[i];
+            p->m[i + 1] = t * b * d[i];
+        }
+    }
+}
+
+/* Cubic Hermite between the control points; beyond the last one the
+ * curve continues along its end tangent.                         */
+static double points_eval(const struct ss_points *p, double x)
+{
+    int n = p->n;
+    if (x >= p->x[n - 1])
+        return p->y[n - 1] + p->m[n - 1] * (x - p->x[n - 1]);
+
+    int i = 0;
+    while (x >= p->x[i + 1])
+        i++;
+
+    double h = p->x[i + 1] - p->x[i];
+    double t = (x - p->x[i]) / h;
+    double t2 = t * t, t3 = t2 * t;
+    return (2 * t3 - 3 * t2 + 1) * p->y[i] +
+           (t3 - 2 * t2 + t) * h * p->m[i] +
+           (-2 * t3 + 3 * t2) * p->y[i + 1] +
+           (t3 - t2) * h * p->m[i + 1];
+}
+
+/*
+ * f(d) = base × cap × x^n / (1 + x^n)  ×  d^4 / (t^4 + d^4)
+ *   x = |d| / cap,  n = ramp-softness,  t = low-cut
+ * unless the curve is given by control points.
+ */
+double ss_curve_eval(const struct ss_curve *c, double abs_d)
+{
+    if (c->expr[0]) {
+        const double *end = &c->table[SS_CURVE_TABLE_SIZE];
+        double slope = (end[0] - end[-1]) / SS_CURVE_TABLE_STEP;
+        double x0 = SS_CURVE_TABLE_SIZE * SS_CURVE_TABLE_STEP;
+        return end[0] + slope * (abs_d - x0);
+    }
+    if (c->points.n > 0)
+        return points_eval(&c->points, abs_d);
+
+    if (c->scroll_cap <= 0.0)
+        return abs_d * c->base_speed;
+
+    double normalized = abs_d / c->scroll_cap;
+
+    if (c->ramp_softness != 1.0 && normalized > 0.0)
+        normalized = pow(normalized, c->ramp_softness);
+
+    double out = c->base_speed * c->scroll_cap * (normalized / (1.0 + normalized));
+
+    if (c->low_cut > 0.0) {
+        double d2 = abs_d * abs_d;
+        double d4 = d2 * d2;
+        double t2 = c->low_cut * c->low_cut;
+        double t4 = t2 * t2;
+        out *= d4 / (t4 + d4);
+    }
+
+    return out;
+}
+
+/* Sample the curve into its table.  A curve that is negative, not
+ * finite or decreasing anywhere in the table is an error (and the
+ * table is patched to stay usable).  Expressions are compiled here
+ * with the curve's parameters folded in and run once per entry.   */
+static int curve_build(struct ss_curve *c, const char *profile,
+                       const char *kind, ss_report_fn report, void *ctx)
+{
+    struct ss_expr_prog prog;
+    double vars[SS_EXPR_NVARS] = {
+        [SS_VAR_D] = NAN, [SS_VAR_X] = NAN,
+        [SS_VAR_BASE] = c->base_speed, [SS_VAR_CAP] = c->scroll_cap,
+        [SS_VAR_N] = c->ramp_softness, [SS_VAR_T] = c->low_cut,
+    };
+    if (c->expr[0]) {
+        char err[120];
+        if (ss_expr_compile(c->expr, vars, &prog, err, sizeof(err)) < 0) {
+            reportf(report, ctx, 0, "%s %s curve-expr: %s",
+                    profile, kind, err);
+            memset(c->table, 0, sizeof(c->table));
+            return 1;
+        }
+    }
+
+    int errors = 0;
+    for (int i = 0; i <= SS_CURVE_TABLE_SIZE; i++) {
+        double d = i * SS_CURVE_TABLE_STEP;
+        double v;
+        if (c->expr[0]) {
+            vars[SS_VAR_D] = d;
+            vars[SS_VAR_X] = d / c->scroll_cap;
+            v = ss_expr_run(&prog, vars);
+        } else {
+            v = ss_curve_eval(c, d);
+        }
+        if (!isfinite(v) || v < 0.0 || (i > 0 && v < c->table[i - 1])) {
+            if (!errors)
+                reportf(report, ctx, 0, "%s %s curve is negative, not "
+                        "finite or decreasing at delta %g",
+                        profile, kind, d);
+            errors = 1;
+            v = i > 0 ? c->table[i - 1] : 0.0;
+        }
+        c->table[i] = v;
+    }
+    return errors;
+}
+
+/* ── Finish / image header ────────────────────────────────── */
+
+static uint64_t checksum(const struct ss_config *c)
+{
+    const unsigned char *p = (const unsigned char *)c;
+    size_t start = offsetof(struct ss_config, discrete_factor);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = start; i < sizeof(*c); i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+int ss_config_finish(struct ss_config *c, ss_report_fn report, void *ctx)
+{
+    int errors = 0;
+
+    for (int i = 0; i < c->nprofiles; i++) {
+        struct ss_profile *p = &c->profiles[i];
+        struct ss_curve *tp = &p->trackpoint;
+        if (p->trackpoint_follows & 1)
+            tp->base_speed = p->finger.base_speed;
+        if (p->trackpoint_follows & 2)
+            tp->scroll_cap = p->finger.scroll_cap;
+        if (p->trackpoint_follows & 4)
+            tp->ramp_softness = p->finger.ramp_softness;
+        if (p->trackpoint_follows & 8)
+            tp->low_cut = p->finger.low_cut;
+        if (p->trackpoint_follows & 16)
+            tp->points = p->finger.points;
+        if (p->trackpoint_follows & 32)
+            memcpy(tp->expr, p->finger.expr, sizeof(tp->expr));
+
+        if (p->finger.points.n > 0)
+            points_fit(&p->finger.points);
+        if (tp->points.n > 0)
+            points_fit(&tp->points);
+
+        errors += curve_build(&p->finger, p->name, "touchpad", report, ctx);
+        errors += curve_build(&p->trackpoint, p->name, "trackpoint",
+                              report, ctx);
+    }
+
+    /* chrome-scroll-factor expands to rules after the explicit ones */
+    static const char *const chrome[] = { "chrome", "chromium", "electron" };
+    c->napp_total = c->napp_rules;
+    if (c->chrome_scroll_factor != 1.0) {
+        for (size_t i = 0; i < 3 && c->napp_total < SS_MAX_APP_RULES; i++) {
+            struct ss_app_rule *r = &c->app_rules[c->napp_total++];
+            snprintf(r->pattern, sizeof(r->pattern), "%s", chrome[i]);
+            r->factor = c->chrome_scroll_factor;
+        }
+    }
+
+    memcpy(c->magic, SS_IMAGE_MAGIC, sizeof(c->magic));
+    c->version = SS_IMAGE_VERSION;
+    c->size = sizeof(*c);
+    c->checksum = checksum(c);
+    return errors;
+}
+
+int ss_config_check_image(const void *p, size_t len)
+{
+    const struct ss_config *c = p;
+    if (len != sizeof(*c) ||
+        memcmp(c->magic, SS_IMAGE_MAGIC, sizeof(c->magic)) != 0 ||
+        c->version != SS_IMAGE_VERSION || c->size != sizeof(*c) ||
+        c->nprofiles < 1 || c->nprofiles > SS_MAX_PROFILES ||
+        c->forced_profile < -1 || c->forced_profile >= c->nprofiles ||
+        c->napp_rules < 0 || c->napp_total < c->napp_rules ||
+        c->napp_total > SS_MAX_APP_RULES ||
+        c->nmonitor_rules < 0 || c->nmonitor_rules > SS_MAX_MONITOR_RULES ||
+        !memchr(c->metrics_file, '\0', sizeof(c->metrics_file)) ||
+        !memchr(c->session_log, '\0', sizeof(c->session_log)))
+        return -1;
+    for (int i = 0; i < c->nprofiles; i++) {
+        const struct ss_profile *p = &c->profiles[i];
+        if (p->finger.points.n < 0 || p->finger.points.n > SS_MAX_CURVE_POINTS ||
+            p->trackpoint.points.n < 0 ||
+            p->trackpoint.points.n > SS_MAX_CURVE_POINTS ||
+            !memchr(p->finger.expr, '\0', sizeof(p->finger.expr)) ||
+            !memchr(p->trackpoint.expr, '\0', sizeof(p->trackpoint.expr)))
+            return -1;
+    }
+    for (int i = 0; i < c->nmonitor_rules; i++)
+        if (!memchr(c->monitor_rules[i].output, '\0',
+                    sizeof(c->monitor_rules[i].output)))
+            return -1;
+    return c->checksum == checksum(c) ? 0 : -1;
+}
+
+/* ── Single-key access / dump ─────────────────────────────── */
+
+int ss_config_find_profile(const struct ss_config *c, const char *name)
+{
+    for (int i = 0; i < c->nprofiles; i++)
+        if (strcmp(c->profiles[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+/* Split "PROFILE.key" into profile index and key; plain keys refer
+ * to profile 0.  Global keys cannot take a profile prefix.         */
+static int split_key(const struct ss_config *c, const char *key,
+                     int *profile, const char **name,
+                     char *err, size_t errlen)
+{
+    const char *dot = strrchr(key, '.');
+    *profile = 0;
+    *name = key;
+    if (!dot)
+        return 0;
+
+    char pname[sizeof(c->profiles[0].name)];
+    size_t len = (size_t)(dot - key);
+    if (len < sizeof(pname)) {
+        memcpy(pname, key, len);
+        pname[len] = '\0';
+        *profile = ss_config_find_profile(c, pname);
+    } else {
+        *profile = -1;
+    }
+    if (*profile < 0) {
+        snprintf(err, errlen, "unknown profile in '%s'", key);
+        return -1;
+    }
+    *name = dot + 1;
+
+    const struct key_desc *k = find_key(*name);
+    if ((k && k->scope == SCOPE_GLOBAL) ||
+        strcmp(*name, "app-scroll-factor") == 0 ||
+        strcmp(*name, "monitor-scroll-factor") == 0) {
+        snprintf(err, errlen, "%s is not a profile key", *name);
+        return -1;
+    }
+    return 0;
+}
+
+struct err_buf {
+    char  *buf;
+    size_t len;
+};
+
+static void report_to_buf(void *ctx, int line, const char *msg)
+{
+    struct err_buf *e = ctx;
+    (void)line;
+    snprintf(e->buf, e->len, "%s", msg);
+}
+
+int ss_config_set(struct ss_config *c, const char *key, const char *val,
+                  char *err, size_t errlen)
+{
+    int profile;
+    const char *name;
+    if (split_key(c, key, &profile, &name, err, errlen) < 0)
+        return -1;
+
+    char v[256];
+    snprintf(v, sizeof(v), "%s", val);
+    trim(v);
+
+    struct err_buf e = { err, errlen };
+    return set_key(c, &c->profiles[profile], name, v, 0,
+                   report_to_buf, &e) ? 0 : -1;
+}
+
+/* Shortest "%g" form that reads back to the same double */
+static void format_double(char *buf, size_t len, double v)
+{
+    snprintf(buf, len, "%.15g", v);
+    if (strtod(buf, NULL) != v)
+        snprintf(buf, len, "%.17g", v);
+}
+
+static void print_key(FILE *out, const struct key_desc *k, const void *base)
+{
+    const char *p = (const char *)base + k->offset;
+    if (k->type == KEY_EXPR || k->type == KEY_STRING) {
+        fprintf(out, "%s=%s\n", k->key, p);
+    } else if (k->type == KEY_POINTS) {
+        const struct ss_points *pts = (const struct ss_points *)p;
+        fprintf(out, "%s=", k->key);
+        for (int i = 0; i < pts->n; i++) {
+            char x[32], y[32];
+            format_double(x, sizeof(x), pts->x[i]);
+            format_double(y, sizeof(y), pts->y[i]);
+            fprintf(out, "%s%s:%s", i ? " " : "", x, y);
+        }
+        fputc('\n', out);
+    } else if (k->type == KEY_DOUBLE) {
+        char num[32];
+        format_double(num, sizeof(num), *(const double *)p);
+        fprintf(out, "%s=%s\n", k->key, num);
+    } else {
+        fprintf(out, "%s=%d\n", k->key, *(const int32_t *)p);
+    }
+}
+
+static void print_app_rules(FILE *out, const struct ss_config *c)
+{
+    for (int i = 0; i < c->napp_rules; i++) {
+        char num[32];
+        format_double(num, sizeof(num), c->app_rules[i].factor);
+        fprintf(out, "app-scroll-factor=%s %s\n",
+                c->app_rules[i].pattern, num);
+    }
+}
+
+static void print_monitor_rules(FILE *out, const struct ss_config *c)
+{
+    for (int i = 0; i < c->nmonitor_rules; i++) {
+        const struct ss_monitor_rule *r = &c->monitor_rules[i];
+        char scale[32] = "", num[32];
+        if (r->scale > 0.0) {
+            scale[0] = '@';
+            format_double(scale + 1, sizeof(scale) - 1, r->scale);
+        }
+        format_double(num, sizeof(num), r->factor);
+        fprintf(out, "monitor-scroll-factor=%s%s %s\n", r->output, scale, num);
+    }
+}
+
+int ss_config_get(const struct ss_config *c, const char *key, FILE *out)
+{
+    int profile;
+    const char *name;
+    char err[80];
+    if (split_key(c, key, &profile, &name, err, sizeof(err)) < 0)
+        return -1;
+
+    const struct ss_profile *p = &c->profiles[profile];
+    if (strcmp(name, "match") == 0) {
+        fprintf(out, "match=%s\n", p->match);
+        return 0;
+    }
+    if (strcmp(name, "app-scroll-factor") == 0) {
+        print_app_rules(out, c);
+        return 0;
+    }
+    if (strcmp(name, "monitor-scroll-factor") == 0) {
+        print_monitor_rules(out, c);
+        return 0;
+    }
+
+    const struct key_desc *k = find_key(name);
+    if (!k)
+        return -1;
+    print_key(out, k, k->scope == SCOPE_PROFILE ? (const void *)p
+                                                : (const void *)c);
+    return 0;
+}
+
+void ss_config_dump(const struct ss_config *c, FILE *out)
+{
+    for (size_t i = 0; i < NKEYS; i++)
+        if (keys[i].scope == SCOPE_GLOBAL)
+            print_key(out, &keys[i], c);
+    print_app_rules(out, c);
+    print_monitor_rules(out, c);
+
+    for (int n = 0; n < c->nprofiles; n++) {
+        const struct ss_profile *p = &c->profiles[n];
+        if (n > 0) {
+            fprintf(out, "\n[profile %s]\n", p->name);
+            if (p->match[0])
+                fprintf(out, "match=%s\n", p->match);
+        }
+        for (size_t i = 0; i < NKEYS; i++) {
+            if (keys[i].scope != SCOPE_PROFILE ||
+                (p->trackpoint_follows & follow_bit(&keys[i])))
+                continue;
+            print_key(out, &keys[i], p);
+        }
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * scroll-speed-config.h — Configuration model shared by the interposer
+ * and scroll-speed-ctl
+ *
+ * struct ss_config is both the snapshot the hot path reads and the
+ * on-disk layout of the compiled image written by
+ * `scroll-speed-ctl compile`: the interposer mmaps the image read-only
+ * and uses it as is.  Any change to the layout must bump
+ * SS_IMAGE_VERSION.  The control socket edits a heap copy through
+ * ss_config_set() and publishes it as a new snapshot.
+ */
+
+#ifndef SCROLL_SPEED_CONFIG_H
+#define SCROLL_SPEED_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SS_IMAGE_MAGIC   "SSPEEDIM"   /* 8 bytes, not NUL-terminated */
+#define SS_IMAGE_VERSION 11
+
+#define SS_CURVE_TABLE_SIZE 1024
+#define SS_CURVE_TABLE_STEP 0.125     /* delta units per entry: 0 … 128 */
+#define SS_MAX_PROFILES     8
+#define SS_MAX_APP_RULES    8
+#define SS_MAX_MONITOR_RULES 8
+#define SS_STOP_SHAPING_MAX 7
+#define SS_MAX_CURVE_POINTS 16
+#define SS_MAX_CURVE_EXPR   192
+#define SS_MAX_PATH         128
+
+/* User-defined curve: control points through which a monotone cubic
+ * (Fritsch–Carlson) is fitted.  m holds the fitted tangents.       */
+struct ss_points {
+    int32_t n;                /* 0 = use the Hill formula */
+    int32_t reserved;
+    double  x[SS_MAX_CURVE_POINTS];
+    double  y[SS_MAX_CURVE_POINTS];
+    double  m[SS_MAX_CURVE_POINTS];
+};
+
+/* Hill-function parameters, control points or an expression (see
+ * scroll-speed-expr.h), plus the output table precomputed from them,
+ * so the hot path is a lookup and one lerp whatever the curve's
+ * shape.  The fields before `table` are the ones trackpoint_follows
+ * refers to, in order.                                             */
+struct ss_curve {
+    double base_speed;
+    double scroll_cap;
+    double ramp_softness;
+    double low_cut;
+    struct ss_points points;
+    char   expr[SS_MAX_CURVE_EXPR];   /* "" = none */
+    double table[SS_CURVE_TABLE_SIZE + 1];
+};
+
+/* Device profile: a touchpad curve (LIBINPUT_EVENT_POINTER_SCROLL_
+ * FINGER), a TrackPoint curve (..._CONTINUOUS) and how raw deltas
+ * are scaled before them.  trackpoint-* keys never set for a profile
+ * follow its touchpad curve.  Profile 0 ("default", the keys outside
+ * any [profile] section) applies to devices no other profile matches. */
+struct ss_profile {
+    char    name[32];
+    char    match[64];       /* device name substring or "vvvv:pppp" */
+    int32_t physical_units;  /* curve input in mm instead of libinput units */
+    uint32_t trackpoint_follows;  /* bit i: trackpoint param i = finger's */
+    struct ss_curve finger;
+    struct ss_curve trackpoint;
+};
+
+/* Per-app scroll factor, applied while the focused window's
+ * executable path contains `pattern`.  The first match wins.  */
+struct ss_app_rule {
+    char   pattern[48];
+    double factor;
+};
+
+/* Per-monitor scroll factor, applied while the pointer is on the
+ * output called `output` (a connector name as Mutter gives it, e.g.
+ * "eDP-1", or "MFG:pppp" from its EDID), at `scale` if non-zero.
+ * The first match wins; it multiplies the app factor.          */
+struct ss_monitor_rule {
+    char   output[32];
+    double scale;
+    double factor;
+};
+
+struct ss_config {
+    /* Image header */
+    char     magic[8];
+    uint32_t version;
+    uint32_t size;            /* sizeof(struct ss_config) */
+    uint64_t checksum;        /* FNV-1a over everything after the header */
+    int64_t  source_mtime;    /* mtime of the text config it came from */
+
+    double  discrete_factor;
+    double  chrome_scroll_factor;
+
+    int32_t trackpoint_velocity;
+    int32_t stop_shaping_events;
+    double  trackpoint_ref_interval;
+
+    double  predict_horizon;
+    double  predict_damping;
+    double  predict_max;
+    double  stop_velocity_max;
+
+    double  wheel_accel_ramp;
+    double  wheel_accel_threshold;
+    double  wheel_accel_max;
+    double  latency_budget;   /* µs per getter call; 0 = no watchdog */
+    char    metrics_file[SS_MAX_PATH];   /* .prom output; "" = none */
+    int32_t metrics_interval; /* seconds between writes */
+    char    session_log[SS_MAX_PATH];    /* .sslog directory; "" = none */
+    int32_t session_log_size; /* KiB per file before rotating */
+    int32_t session_log_files;   /* files kept in session_log */
+
+    int32_t latency_stats;    /* event age histogram (control socket stats) */
+    int32_t dequeue_transform;   /* transform at libinput_get_event() */
+    int32_t event_tap;        /* shared-memory ring for scroll-speed-tap */
+    int32_t latency_budget_overruns;   /* per window before passthrough */
+    int32_t nprofiles;
+    int32_t forced_profile;   /* switch-profile override; -1 = match devices */
+    int32_t napp_rules;       /* app-scroll-factor rules */
+    int32_t napp_total;       /* plus the chrome-scroll-factor expansion */
+    int32_t nmonitor_rules;   /* monitor-scroll-factor rules */
+    int32_t reserved;
+    struct ss_profile  profiles[SS_MAX_PROFILES];
+    struct ss_app_rule app_rules[SS_MAX_APP_RULES];
+    struct ss_monitor_rule monitor_rules[SS_MAX_MONITOR_RULES];
+};
+
+/* Receives parse/validation errors; line is 0 when not tied to one. */
+typedef void (*ss_report_fn)(void *ctx, int line, const char *msg);
+
+/* Built-in defaults (zeroes padding, so checksums are reproducible). */
+void ss_config_defaults(struct ss_config *c);
+
+/* Parse a text config on top of `c`.  Invalid lines are reported and
+ * skipped; returns the number of errors.                            */
+int ss_config_parse(struct ss_config *c, FILE *f,
+                    ss_report_fn report, void *ctx);
+
+/* Resolve trackpoint fallbacks and app rules, build the curve tables
+ * and fill in the image header.  Returns the number of validation
+ * errors (non-finite or decreasing curves).  May be called again
+ * after ss_config_set().                                            */
+int ss_config_finish(struct ss_config *c, ss_report_fn report, void *ctx);
+
+/* Single-key access for the control socket.  `key` is a conf key,
+ * optionally prefixed with "PROFILE." for profile keys (default:
+ * profile 0).  set returns 0 or -1 with the reason in `err`; get
+ * writes "key=value" line(s) and returns -1 for an unknown key.    */
+int ss_config_set(struct ss_config *c, const char *key, const char *val,
+                  char *err, size_t errlen);
+int ss_config_get(const struct ss_config *c, const char *key, FILE *out);
+
+/* Index of the profile called `name`, or -1. */
+int ss_config_find_profile(const struct ss_config *c, const char *name);
+
+/* The whole snapshot in conf syntax (parses back to the same config). */
+void ss_config_dump(const struct ss_config *c, FILE *out);
+
+/* 0 if `p` (len bytes) is a complete image of this version. */
+int ss_config_check_image(const void *p, size_t len);
+
+/* Curve output for |delta|, evaluated from the parameters or the
+ * fitted spline (tangents computed by ss_config_finish).  Expression
+ * curves exist only as their table: beyond it they continue along
+ * its last segment.                                               */
+double ss_curve_eval(const struct ss_curve *c, double abs_d);
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * scroll-speed-ctl.c — Management command for libscroll-speed
+ *
+ *   scroll-speed-ctl compile [CONF [OUT]]
+ *     Checks a text config and writes the binary image (CONF.bin by
+ *     default) with the parameters, app rules and precomputed curve
+ *     tables, which the interposer mmaps and uses as is, without
+ *     parsing.  On an error nothing is written and the exit code is 1.
+ *
+ *   scroll-speed-ctl [-s SOCKET] get KEY
+ *   scroll-speed-ctl [-s SOCKET] set KEY VALUE
+ *   scroll-speed-ctl [-s SOCKET] dump
+ *   scroll-speed-ctl [-s SOCKET] switch-profile NAME|auto
+ *   scroll-speed-ctl [-s SOCKET] stats [reset]
+ *   scroll-speed-ctl [-s SOCKET] version
+ *   scroll-speed-ctl [-s SOCKET] reload-engine
+ *     Query or change the interposer inside the running compositor
+ *     (gnome-shell) through its control socket
+ *     ($XDG_RUNTIME_DIR/scroll-speed.sock by default).  Profile keys
+ *     are "PROFILE.KEY" (default if left out).  stats is the
+ *     per-source histogram of event age (libinput timestamp to the
+ *     getter call, collected with latency-stats=1) and the record of
+ *     latency-budget passthrough trips.  reload-engine makes the
+ *     engine symlink be checked again right away.
+ *
+ * Build:
+ *   gcc -O2 -o scroll-speed-ctl scroll-speed-ctl.c scroll-speed-config.c \
+ *       scroll-speed-expr.c -lm
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "scroll-speed-config.h"
+
+#define CONF_PATH "/etc/scroll-speed.conf"
+
+#define SOCKET_NAME "scroll-speed.sock"
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: scroll-speed-ctl compile [CONF [OUT]]\n"
+            "       scroll-speed-ctl [-s SOCKET] get KEY\n"
+            "       scroll-speed-ctl [-s SOCKET] set KEY VALUE\n"
+            "       scroll-speed-ctl [-s SOCKET] dump\n"
+            "       scroll-speed-ctl [-s SOCKET] switch-profile NAME|auto\n"
+            "       scroll-speed-ctl [-s SOCKET] stats [reset]\n"
+            "       scroll-speed-ctl [-s SOCKET] version|reload-engine\n"
+            "  CONF    text config (default " CONF_PATH ")\n"
+            "  OUT     compiled image (default CONF.bin)\n"
+            "  KEY     conf key, PROFILE.KEY for a profile's key\n"
+            "  SOCKET  control socket (default $XDG_RUNTIME_DIR/" SOCKET_NAME ")\n");
+}
+
+static void print_error(void *ctx, int line, const char *msg)
+{
+    const char *path = ctx;
+    if (line)
+        fprintf(stderr, "%s:%d: %s\n", path, line, msg);
+    else
+        fprintf(stderr, "%s: %s\n", path, msg);
+}
+
+/* ── compile ──────────────────────────────────────────────── */
+
+/* Write via a temp file + rename, so a process that has the old image
+ * mmap'd keeps its (unlinked) copy instead of seeing a torn one.     */
+static int write_image(const char *out, const struct ss_config *c)
+{
+    char tmp[4096 + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", out);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", tmp, strerror(errno));
+        return -1;
+    }
+    int ok = fwrite(c, sizeof(*c), 1, f) == 1;
+    ok &= fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok &= fclose(f) == 0;
+    if (!ok || chmod(tmp, 0644) != 0 || rename(tmp, out) != 0) {
+        fprintf(stderr, "%s: %s\n", out, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static int cmd_compile(int argc, char **argv)
+{
+    const char *conf = argc > 0 ? argv[0] : CONF_PATH;
+    char out[4096];
+    snprintf(out, sizeof(out), "%s.bin", conf);
+    if (argc > 1)
+        snprintf(out, sizeof(out), "%s", argv[1]);
+
+    FILE *f = fopen(conf, "r");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", conf, strerror(errno));
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0) {
+        fprintf(stderr, "%s: %s\n", conf, strerror(errno));
+        fclose(f);
+        return 1;
+    }
+
+    static struct ss_config c;
+    ss_config_defaults(&c);
+    c.source_mtime = st.st_mtime;
+    int errors = ss_config_parse(&c, f, print_error, (void *)conf);
+    fclose(f);
+    errors += ss_config_finish(&c, print_error, (void *)conf);
+
+    if (errors) {
+        fprintf(stderr, "%s: %d error(s), image not written\n", conf, errors);
+        return 1;
+    }
+    if (write_image(out, &c) < 0)
+        return 1;
+
+    printf("%s -> %s (v%u, %zu bytes, %d profile(s), %d app rule(s), "
+           "%d monitor rule(s), checksum %016llx)\n",
+           conf, out, c.version, sizeof(c), c.nprofiles, c.napp_rules,
+           c.nmonitor_rules, (unsigned long long)c.checksum);
+    return 0;
+}
+
+/* ── Control socket client ────────────────────────────────── */
+
+static int socket_path(const char *opt, struct sockaddr_un *addr)
+{
+    const char *env = getenv("SCROLL_SPEED_SOCKET");
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    int n;
+    if (opt)
+        n = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s", opt);
+    else if (env && *env)
+        n = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s", env);
+    else if (dir && *dir)
+        n = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/%s",
+                     dir, SOCKET_NAME);
+    else {
+        fprintf(stderr, "XDG_RUNTIME_DIR is not set; use -s SOCKET\n");
+        return -1;
+    }
+    if (n < 0 || (size_t)n >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "socket path too long\n");
+        return -1;
+    }
+    addr->sun_family = AF_UNIX;
+    return 0;
+}
+
+/* Send the request line, copy the reply to stdout.  Exit status 1
+ * when the interposer answers "error: ...".                      */
+static int cmd_request(const char *sock, const char *request)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (socket_path(sock, &addr) < 0)
+        return 1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "%s: %s (is the compositor running with "
+                "libscroll-speed?)\n", addr.sun_path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    size_t len = strlen(request);
+    if (send(fd, request, len, MSG_NOSIGNAL) != (ssize_t)len ||
+        send(fd, "\n", 1, MSG_NOSIGNAL) != 1) {
+        fprintf(stderr, "%s: %s\n", addr.sun_path, strerror(errno));
+        close(fd);
+        return 1;
+    }
+    shutdown(fd, SHUT_WR);
+
+    char buf[4096];
+    ssize_t r;
+    int first = 1, failed = 0;
+    while ((r = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        if (first && r >= 6 && memcmp(buf, "error:", 6) == 0)
+            failed = 1;
+        first = 0;
+        fwrite(buf, 1, (size_t)r, failed ? stderr : stdout);
+    }
+    close(fd);
+    if (first) {
+        fprintf(stderr, "%s: no reply\n", addr.sun_path);
+        return 1;
+    }
+    return failed;
+}
+
+/* ── Main ─────────────────────────────────────────────────── */
+
+int main(int argc, char **argv)
+{
+    const char *sock = NULL;
+    if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+        sock = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+
+    const char *cmd = argv[1];
+    if (strcmp(cmd, "compile") == 0 && !sock)
+        return cmd_compile(argc - 2, argv + 2);
+
+    char request[512];
+    if ((strcmp(cmd, "dump") == 0 || strcmp(cmd, "version") == 0 ||
+         strcmp(cmd, "reload-engine") == 0 || strcmp(cmd, "stats") == 0) &&
+        argc == 2)
+        snprintf(request, sizeof(request), "%s", cmd);
+    else if (strcmp(cmd, "stats") == 0 && argc == 3 &&
+             strcmp(argv[2], "reset") == 0)
+        snprintf(request, sizeof(request), "stats reset");
+    else if ((strcmp(cmd, "get") == 0 ||
+              strcmp(cmd, "switch-profile") == 0) && argc == 3)
+        snprintf(request, sizeof(request), "%s %s", cmd, argv[2]);
+    else if (strcmp(cmd, "set") == 0 && argc >= 4) {
+        /* app-scroll-factor values contain a space: join the rest */
+        int n = snprintf(request, sizeof(request), "set %s", argv[2]);
+        for (int i = 3; i < argc && n > 0 && (size_t)n < sizeof(request); i++)
+            n += snprintf(request + n, sizeof(request) - (size_t)n,
+                          " %s", argv[i]);
+    } else {
+        usage();
+        return 2;
+    }
+    if (strchr(request, '\n')) {
+        fprintf(stderr, "newline in argument\n");
+        return 2;
+    }
+    return cmd_request(sock, request);
+}
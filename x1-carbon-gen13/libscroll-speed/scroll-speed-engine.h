@@ -0,0 +1,76 @@
+/*
+ * scroll-speed-engine.h — ABI between the interposer shim and the engine
+ *
+ * libscroll-speed.so (the shim, scroll-speed-shim.c) is what
+ * /etc/ld.so.preload loads.  It only exports the interposed libinput
+ * functions and forwards them to an engine (scroll-speed.c and friends)
+ * dlopen'ed from libscroll-speed-engine.so, which the shim can swap
+ * for a newer build while the compositor keeps running.
+ *
+ * The shim never changes in a way that matters to an engine without
+ * SS_ENGINE_ABI being bumped; an engine built for another ABI is
+ * refused and the current one stays.
+ */
+
+#ifndef SCROLL_SPEED_ENGINE_H
+#define SCROLL_SPEED_ENGINE_H
+
+#include <stdint.h>
+#include <libinput.h>
+
+#define SS_ENGINE_ABI   4
+#define SS_ENGINE_ENTRY "scroll_speed_engine"
+
+/* Both libraries build with -fvisibility=hidden and a version script
+ * (libscroll-speed.ver, libscroll-speed-engine.ver); the few symbols
+ * the dynamic linker must see are marked with this.                */
+#define SS_EXPORT __attribute__((visibility("default")))
+
+/* Services the shim offers to the engine. */
+struct ss_host {
+    uint32_t    abi;
+    const char *version;                  /* shim version */
+    /* Real libinput symbol.  The engine must not dlsym(RTLD_NEXT or
+     * RTLD_DEFAULT) the interposed getters itself: from a dlopen'ed
+     * object those resolve back to the shim.                      */
+    void      *(*resolve)(const char *symbol);
+    /* Ask for the engine to be reloaded; the shim's watcher thread
+     * does it right away.  Returns at once (the swap joins the
+     * caller's thread, so it must not wait for it).               */
+    void       (*request_swap)(void);
+    /* sem_post(sem), as a GDestroyNotify: for a callback that may run
+     * after the engine is unloaded, so it cannot be the engine's.  */
+    void       (*post_sem)(void *sem);
+};
+
+/* Returned by the engine's SS_ENGINE_ENTRY function. */
+struct ss_engine {
+    uint32_t    abi;
+    const char *version;
+    /* Resolve symbols and load the config.  No threads yet; 0 = ok. */
+    int       (*init)(const struct ss_host *host);
+    /* Background threads (config reloads, control socket).  Called
+     * once the engine is the active one.                            */
+    void      (*start)(void);
+    /* Stop the threads and release everything, before dlclose.  No
+     * getter calls are in flight.  Non-zero: something outside the
+     * engine may still call into it (a main-loop callback that was
+     * not let go), so it must stay mapped.                          */
+    int       (*shutdown)(void);
+    double    (*scroll_value)(struct libinput_event_pointer *event,
+                              enum libinput_pointer_axis axis);
+    double    (*scroll_value_v120)(struct libinput_event_pointer *event,
+                                   enum libinput_pointer_axis axis);
+    /* libinput_get_event() returned `event` (never NULL), before the
+     * caller sees it.                                              */
+    void      (*dequeued)(struct libinput_event *event);
+    /* A new batch of events: libinput_dispatch() ran, or
+     * libinput_get_event() found the queue empty.                  */
+    void      (*batch)(void);
+};
+
+typedef const struct ss_engine *(*ss_engine_entry_fn)(void);
+
+SS_EXPORT const struct ss_engine *scroll_speed_engine(void);
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * scroll-speed-expr.c — Curve expression parser and bytecode
+ *
+ * Recursive descent into a fixed node pool, folding every node whose
+ * operands are constant as it is built, then a post-order walk that
+ * assigns registers by depth.  Nothing is allocated.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scroll-speed-expr.h"
+
+enum {
+    OP_CONST, OP_VAR,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW, OP_NEG,
+    OP_MIN, OP_MAX, OP_SQRT, OP_EXP, OP_LOG, OP_ABS,
+    OP_CLAMP, OP_SMOOTHSTEP,
+};
+
+static const uint8_t arity[] = {
+    [OP_CONST] = 0, [OP_VAR] = 0,
+    [OP_ADD] = 2, [OP_SUB] = 2, [OP_MUL] = 2, [OP_DIV] = 2, [OP_POW] = 2,
+    [OP_NEG] = 1,
+    [OP_MIN] = 2, [OP_MAX] = 2, [OP_SQRT] = 1, [OP_EXP] = 1, [OP_LOG] = 1,
+    [OP_ABS] = 1, [OP_CLAMP] = 3, [OP_SMOOTHSTEP] = 3,
+};
+
+static const struct {
+    const char *name;
+    int         op;
+} funcs[] = {
+    { "min", OP_MIN }, { "max", OP_MAX }, { "pow", OP_POW },
+    { "sqrt", OP_SQRT }, { "exp", OP_EXP }, { "log", OP_LOG },
+    { "abs", OP_ABS }, { "clamp", OP_CLAMP }, { "smoothstep", OP_SMOOTHSTEP },
+};
+
+static const char *const var_names[SS_EXPR_NVARS] = {
+    [SS_VAR_D] = "d", [SS_VAR_X] = "x", [SS_VAR_BASE] = "base",
+    [SS_VAR_CAP] = "cap", [SS_VAR_N] = "n", [SS_VAR_T] = "t",
+};
+
+static double apply(int op, double a, double b, double c)
+{
+    switch (op) {
+    case OP_ADD:   return a + b;
+    case OP_SUB:   return a - b;
+    case OP_MUL:   return a * b;
+    case OP_DIV:   return a / b;
+    case OP_POW:   return pow(a, b);
+    case OP_NEG:   return -a;
+    case OP_MIN:   return fmin(a, b);
+    case OP_MAX:   return fmax(a, b);
+    case OP_SQRT:  return sqrt(a);
+    case OP_EXP:   return exp(a);
+    case OP_LOG:   return log(a);
+    case OP_ABS:   return fabs(a);
+    case OP_CLAMP: return fmin(fmax(a, b), c);
+    case OP_SMOOTHSTEP: {
+        double t = fmin(fmax((c - a) / (b - a), 0.0), 1.0);
+        return t * t * (3.0 - 2.0 * t);
+    }
+    }
+    return NAN;
+}
+
+/* ── Parser ───────────────────────────────────────────────── */
+
+#define MAX_NODES 128
+
+struct node {
+    uint8_t op;
+    uint8_t var;
+    int     arg[3];
+    double  k;
+};
+
+struct parser {
+    const char   *p;
+    const double *bind;
+    struct node   nodes[MAX_NODES];
+    int           nnodes;
+    char         *err;
+    size_t        errlen;
+};
+
+static int fail(struct parser *ps, const char *fmt, ...)
+{
+    if (!ps->err[0]) {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(ps->err, ps->errlen, fmt, ap);
+        va_end(ap);
+    }
+    return -1;
+}
+
+static void skip_space(struct parser *ps)
+{
+    while (*ps->p == ' ' || *ps->p == '\t')
+        ps->p++;
+}
+
+static int new_node(struct parser *ps, int op)
+{
+    if (ps->nnodes == MAX_NODES)
+        return fail(ps, "expression too long");
+    struct node *n = &ps->nodes[ps->nnodes];
+    memset(n, 0, sizeof(*n));
+    n->op = (uint8_t)op;
+    return ps->nnodes++;
+}
+
+static int constant(struct parser *ps, double k)
+{
+    int i = new_node(ps, OP_CONST);
+    if (i >= 0)
+        ps->nodes[i].k = k;
+    return i;
+}
+
+/* Operator node, folded to a constant when all operands are */
+static int operator(struct parser *ps, int op, int a, int b, int c)
+{
+    int args[3] = { a, b, c };
+    double v[3] = { 0.0, 0.0, 0.0 };
+    int folded = 1;
+    for (int i = 0; i < arity[op]; i++) {
+        if (args[i] < 0)
+            return -1;
+        if (ps->nodes[args[i]].op == OP_CONST)
+            v[i] = ps->nodes[args[i]].k;
+        else
+            folded = 0;
+    }
+    if (folded)
+        return constant(ps, apply(op, v[0], v[1], v[2]));
+
+    int i = new_node(ps, op);
+    if (i >= 0)
+        memcpy(ps->nodes[i].arg, args, sizeof(args));
+    return i;
+}
+
+static int parse_expr(struct parser *ps);
+
+static int parse_call(struct parser *ps, int op, const char *name)
+{
+    int args[3] = { -1, -1, -1 };
+    ps->p++;   /* '(' */
+    for (int i = 0; i < arity[op]; i++) {
+        if (i > 0) {
+            skip_space(ps);
+            if (*ps->p != ',')
+                return fail(ps, "%s() takes %d arguments", name, arity[op]);
+            ps->p++;
+        }
+        if ((args[i] = parse_expr(ps)) < 0)
+            return -1;
+    }
+    skip_space(ps);
+    if (*ps->p != ')')
+        return fail(ps, "%s() takes %d arguments", name, arity[op]);
+    ps->p++;
+    return operator(ps, op, args[0], args[1], args[2]);
+}
+
+static int parse_primary(struct parser *ps)
+{
+    skip_space(ps);
+    const char *s = ps->p;
+
+    if (isdigit((unsigned char)*s) || *s == '.') {
+        char *end;
+        double k = strtod(s, &end);
+        if (end == s)
+            return fail(ps, "bad number at '%s'", s);
+        ps->p = end;
+        return constant(ps, k);
+    }
+
+    if (*s == '(') {
+        ps->p++;
+        int e = parse_expr(ps);
+        skip_space(ps);
+        if (e >= 0 && *ps->p != ')')
+            return fail(ps, "missing ')'");
+        ps->p++;
+        return e;
+    }
+
+    if (isalpha((unsigned char)*s)) {
+        char name[16];
+        size_t len = 0;
+        while (isalnum((unsigned char)s[len]) || s[len] == '_')
+            len++;
+        if (len >= sizeof(name))
+            return fail(ps, "unknown name '%.*s'", (int)len, s);
+        memcpy(name, s, len);
+        name[len] = '\0';
+        ps->p = s + len;
+
+        skip_space(ps);
+        if (*ps->p == '(') {
+            for (size_t i = 0; i < sizeof(funcs) / sizeof(funcs[0]); i++)
+                if (strcmp(funcs[i].name, name) == 0)
+                    return parse_call(ps, funcs[i].op, name);
+            return fail(ps, "unknown function '%s'", name);
+        }
+        for (int v = 0; v < SS_EXPR_NVARS; v++) {
+            if (strcmp(var_names[v], name) != 0)
+                continue;
+            if (!isnan(ps->bind[v]))
+                return constant(ps, ps->bind[v]);
+            int i = new_node(ps, OP_VAR);
+            if (i >= 0)
+                ps->nodes[i].var = (uint8_t)v;
+            return i;
+        }
+        return fail(ps, "unknown name '%s'", name);
+    }
+
+    return fail(ps, *s ? "unexpected '%c'" : "unexpected end", *s);
+}
+
+/* unary := '-' unary | primary ['^' unary]   (so -x^2 = -(x^2)) */
+static int parse_unary(struct parser *ps)
+{
+    skip_space(ps);
+    if (*ps->p == '-') {
+        ps->p++;
+        return operator(ps, OP_NEG, parse_unary(ps), -1, -1);
+    }
+    int base = parse_primary(ps);
+    skip_space(ps);
+    if (base >= 0 && *ps->p == '^') {
+        ps->p++;
+        return operator(ps, OP_POW, base, parse_unary(ps), -1);
+    }
+    return base;
+}
+
+static int parse_term(struct parser *ps)
+{
+    int lhs = parse_unary(ps);
+    for (;;) {
+        skip_space(ps);
+        char c = *ps->p;
+        if (lhs < 0 || (c != '*' && c != '/'))
+            return lhs;
+        ps->p++;
+        lhs = operator(ps, c == '*' ? OP_MUL : OP_DIV,
+                       lhs, parse_unary(ps), -1);
+    }
+}
+
+static int parse_expr(struct parser *ps)
+{
+    int lhs = parse_term(ps);
+    for (;;) {
+        skip_space(ps);
+        char c = *ps->p;
+        if (lhs < 0 || (c != '+' && c != '-'))
+            return lhs;
+        ps->p++;
+        lhs = operator(ps, c == '+' ? OP_ADD : OP_SUB,
+                       lhs, parse_term(ps), -1);
+    }
+}
+
+/* ── Code generation ──────────────────────────────────────── */
+
+/* Result of node i goes to register `reg`; operands use reg, reg+1… */
+static int emit(struct parser *ps, struct ss_expr_prog *prog, int i, int reg)
+{
+    const struct node *n = &ps->nodes[i];
+    if (reg + (arity[n->op] ? arity[n->op] - 1 : 0) >= SS_EXPR_MAX_REGS)
+        return fail(ps, "expression nested too deeply");
+
+    for (int j = 0; j < arity[n->op]; j++)
+        if (emit(ps, prog, n->arg[j], reg + j) < 0)
+            return -1;
+
+    if (prog->ncode == SS_EXPR_MAX_CODE)
+        return fail(ps, "expression too long");
+    struct ss_expr_insn *in = &prog->code[prog->ncode++];
+    in->op = n->op;
+    in->dst = (uint8_t)reg;
+    in->a = n->op == OP_VAR ? n->var : (uint8_t)reg;
+    in->b = (uint8_t)(reg + 1);
+    in->c = (uint8_t)(reg + 2);
+    in->k = n->k;
+    return 0;
+}
+
+int ss_expr_compile(const char *src, const double bind[SS_EXPR_NVARS],
+                    struct ss_expr_prog *prog, char *err, size_t errlen)
+{
+    struct parser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = src;
+    ps.bind = bind;
+    ps.err = err;
+    ps.errlen = errlen;
+    err[0] = '\0';
+
+    int root = parse_expr(&ps);
+    skip_space(&ps);
+    if (root >= 0 && *ps.p)
+        root = fail(&ps, "unexpected '%c'", *ps.p);
+    if (root < 0)
+        return -1;
+
+    memset(prog, 0, sizeof(*prog));
+    return emit(&ps, prog, root, 0);
+}
+
+double ss_expr_run(const struct ss_expr_prog *prog,
+                   const double vars[SS_EXPR_NVARS])
+{
+    double r[SS_EXPR_MAX_REGS + 2] = { 0 };
+    for (int i = 0; i < prog->ncode; i++) {
+        const struct ss_expr_insn *in = &prog->code[i];
+        switch (in->op) {
+        case OP_CONST:
+            r[in->dst] = in->k;
+            break;
+        case OP_VAR:
+            r[in->dst] = vars[in->a];
+            break;
+        default:
+            r[in->dst] = apply(in->op, r[in->a], r[in->b], r[in->c]);
+            break;
+        }
+    }
+    return r[0];
+}
@@ -0,0 +1,52 @@
+/*
+ * scroll-speed-expr.h — Curve expressions (curve-expr=...)
+ *
+ * An expression in d (|delta|) and the curve's parameters is parsed,
+ * constant-folded and compiled to a small register bytecode.  It only
+ * runs while a config is being built, to fill the curve table; the
+ * event path never sees it.
+ *
+ *   numbers, + - * / ^ (right-assoc), unary -, ( )
+ *   d      |delta|
+ *   x      d / cap
+ *   base cap n t   base-speed, scroll-cap, ramp-softness, low-cut
+ *   min(a,b) max(a,b) pow(a,b) sqrt(a) exp(a) log(a) abs(a)
+ *   clamp(v,lo,hi) smoothstep(e0,e1,v)
+ */
+
+#ifndef SCROLL_SPEED_EXPR_H
+#define SCROLL_SPEED_EXPR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum ss_expr_var {
+    SS_VAR_D, SS_VAR_X, SS_VAR_BASE, SS_VAR_CAP, SS_VAR_N, SS_VAR_T,
+    SS_EXPR_NVARS
+};
+
+#define SS_EXPR_MAX_CODE 64
+#define SS_EXPR_MAX_REGS 16
+
+struct ss_expr_insn {
+    uint8_t op;
+    uint8_t dst, a, b, c;   /* registers; a = variable index for loads */
+    double  k;              /* constant for loads */
+};
+
+struct ss_expr_prog {
+    int ncode;
+    struct ss_expr_insn code[SS_EXPR_MAX_CODE];
+};
+
+/* Compile `src`.  bind[v] is the value of variable v, or NAN to leave
+ * it free (supplied to ss_expr_run); bound variables are folded in as
+ * constants.  Returns 0, or -1 with the reason in `err`.            */
+int ss_expr_compile(const char *src, const double bind[SS_EXPR_NVARS],
+                    struct ss_expr_prog *prog, char *err, size_t errlen);
+
+/* Evaluate with the free variables taken from vars[]. */
+double ss_expr_run(const struct ss_expr_prog *prog,
+                   const double vars[SS_EXPR_NVARS]);
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * scroll-speed-log.c — Session log encoder and streaming decoder
+ *
+ * Varints are LEB128 (7 bits per byte, low first); signed values are
+ * zigzag-mapped first.  The writer goes through stdio's buffer, the
+ * reader a record at a time, so neither holds more than one record.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "scroll-speed-log.h"
+
+#define TAG_CONTROL  3u
+#define TAG_H        (1u << 2)
+#define TAG_SAMETIME (1u << 3)
+
+enum { CTL_DEVICE, CTL_TIME, CTL_DROPPED };
+
+#define VARINT_MAX 10   /* bytes for a uint64_t */
+
+/* ── Encoding ─────────────────────────────────────────────── */
+
+static int put_varint(uint8_t *p, uint64_t v)
+{
+    int n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/* Quantized value: exact v120 for wheels (degrees * 8), 1/QUANT
+ * otherwise; clamped so a stray huge double cannot overflow.     */
+static int64_t quantize(int source, double value)
+{
+    double q = value * (source == SS_LOG_WHEEL ? 8.0 : SS_LOG_QUANT);
+    if (!isfinite(q))
+        return 0;
+    return llround(fmin(fmax(q, -1e15), 1e15));
+}
+
+static int emit(struct ss_log_writer *w, const uint8_t *buf, int n)
+{
+    if (!w->f)
+        return -1;
+    if (fwrite(buf, 1, (size_t)n, w->f) != (size_t)n)
+        return -1;
+    w->bytes += n;
+    return 0;
+}
+
+static int emit_time(struct ss_log_writer *w, uint64_t t)
+{
+    uint8_t buf[1 + VARINT_MAX];
+    buf[0] = TAG_CONTROL | CTL_TIME << 2;
+    int n = 1 + put_varint(buf + 1, t);
+    if (emit(w, buf, n) < 0)
+        return -1;
+    w->time = t;
+    w->have_time = 1;
+    return 0;
+}
+
+int ss_log_open(struct ss_log_writer *w, const char *path)
+{
+    memset(w, 0, sizeof(*w));
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return -1;
+    w->f = fdopen(fd, "w");
+    if (!w->f) {
+        close(fd);
+        return -1;
+    }
+    uint8_t buf[8 + 1 + VARINT_MAX];
+    memcpy(buf, SS_LOG_MAGIC, 8);
+    buf[8] = SS_LOG_VERSION;
+    int n = 9 + put_varint(buf + 9, (uint64_t)time(NULL));
+    if (emit(w, buf, n) < 0) {
+        int err = errno;
+        fclose(w->f);
+        w->f = NULL;
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int ss_log_event(struct ss_log_writer *w, const struct ss_log_event *e)
+{
+    if (!w->have_time || e->time_usec < w->time)
+        if (emit_time(w, e->time_usec) < 0)
+            return -1;
+
+    uint8_t buf[1 + 2 * VARINT_MAX];
+    uint64_t dt = e->time_usec - w->time;
+    buf[0] = (uint8_t)((unsigned)e->source & 3u);
+    if (e->axis)
+        buf[0] |= TAG_H;
+    int n = 1;
+    if (dt == 0)
+        buf[0] |= TAG_SAMETIME;
+    else
+        n += put_varint(buf + n, dt);
+    n += put_varint(buf + n, zigzag(quantize(e->source, e->value)));
+    if (emit(w, buf, n) < 0)
+        return -1;
+    w->time = e->time_usec;
+    return 0;
+}
+
+int ss_log_device(struct ss_log_writer *w, const struct ss_log_device *d)
+{
+    uint8_t buf[1 + 4 * VARINT_MAX + 1 + sizeof(d->name)];
+    size_t len = strnlen(d->name, sizeof(d->name) - 1);
+    buf[0] = TAG_CONTROL | CTL_DEVICE << 2;
+    int n = 1;
+    n += put_varint(buf + n, d->vendor);
+    n += put_varint(buf + n, d->product);
+    n += put_varint(buf + n, (uint64_t)llround(fmax(d->width, 0.0) * 10.0));
+    n += put_varint(buf + n, (uint64_t)llround(fmax(d->height, 0.0) * 10.0));
+    buf[n++] = (uint8_t)len;
+    memcpy(buf + n, d->name, len);
+    return emit(w, buf, n + (int)len);
+}
+
+int ss_log_dropped(struct ss_log_writer *w, uint64_t count)
+{
+    uint8_t buf[1 + VARINT_MAX];
+    buf[0] = TAG_CONTROL | CTL_DROPPED << 2;
+    return emit(w, buf, 1 + put_varint(buf + 1, count));
+}
+
+int ss_log_flush(struct ss_log_writer *w)
+{
+    if (!w->f)
+        return -1;
+    return fflush(w->f) == 0 && !ferror(w->f) ? 0 : -1;
+}
+
+int ss_log_close(struct ss_log_writer *w)
+{
+    if (!w->f)
+        return -1;
+    int rc = fclose(w->f) == 0 ? 0 : -1;
+    w->f = NULL;
+    return rc;
+}
+
+/* ── Decoding ─────────────────────────────────────────────── */
+
+/* 1, 0 at a clean end of file (or one cut short), -1 if malformed */
+static int get_varint(FILE *f, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(f);
+        if (c == EOF)
+            return 0;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return 1;
+    }
+    return -1;
+}
+
+int ss_log_reader_open(struct ss_log_reader *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "re");
+    if (!r->f)
+        return -1;
+    char magic[8];
+    uint64_t created;
+    if (fread(magic, 1, 8, r->f) != 8 || memcmp(magic, SS_LOG_MAGIC, 8) ||
+        getc(r->f) != SS_LOG_VERSION || get_varint(r->f, &created) != 1) {
+        fclose(r->f);
+        r->f = NULL;
+        errno = EINVAL;
+        return -1;
+    }
+    r->created = (int64_t)created;
+    return 0;
+}
+
+static int read_device(struct ss_log_reader *r)
+{
+    uint64_t v[4];
+    for (int i = 0; i < 4; i++) {
+        int rc = get_varint(r->f, &v[i]);
+        if (rc <= 0)
+            return rc;
+    }
+    int len = getc(r->f);
+    if (len == EOF)
+        return 0;
+    if ((size_t)len >= sizeof(r->device.name) || v[0] > 0xffff ||
+        v[1] > 0xffff)
+        return -1;
+    char name[sizeof(r->device.name)];
+    if (fread(name, 1, (size_t)len, r->f) != (size_t)len)
+        return 0;
+    name[len] = '\0';
+    r->device.vendor = (unsigned)v[0];
+    r->device.product = (unsigned)v[1];
+    r->device.width = (double)v[2] / 10.0;
+    r->device.height = (double)v[3] / 10.0;
+    memcpy(r->device.name, name, (size_t)len + 1);
+    return SS_LOG_DEVICE;
+}
+
+int ss_log_next(struct ss_log_reader *r, struct ss_log_event *e)
+{
+    for (;;) {
+        int tag = getc(r->f);
+        if (tag == EOF)
+            return SS_LOG_END;
+        uint64_t v;
+        int rc;
+
+        if ((tag & 3) == TAG_CONTROL) {
+            switch (tag >> 2) {
+            case CTL_DEVICE:
+                return read_device(r);
+            case CTL_TIME:
+                if ((rc = get_varint(r->f, &v)) <= 0)
+                    return rc;
+                r->time = v;
+                r->have_time = 1;
+                continue;
+            case CTL_DROPPED:
+                if ((rc = get_varint(r->f, &v)) <= 0)
+                    return rc;
+                r->dropped += v;
+                continue;
+            default:
+                return -1;
+            }
+        }
+
+        if (!r->have_time || (tag & 0xf0))
+            return -1;
+        uint64_t dt = 0;
+        if (!(tag & TAG_SAMETIME) && (rc = get_varint(r->f, &dt)) <= 0)
+            return rc;
+        if ((rc = get_varint(r->f, &v)) <= 0)
+            return rc;
+        r->time += dt;
+        e->time_usec = r->time;
+        e->source = tag & 3;
+        e->axis = !!(tag & TAG_H);
+        e->value = (double)unzigzag(v) /
+                   (e->source == SS_LOG_WHEEL ? 8.0 : SS_LOG_QUANT);
+        return SS_LOG_EVENT;
+    }
+}
+
+void ss_log_reader_close(struct ss_log_reader *r)
+{
+    if (r->f)
+        fclose(r->f);
+    r->f = NULL;
+}
+
+int ss_log_is_log(const char *path)
+{
+    char magic[8];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    int ok = read(fd, magic, 8) == 8 && memcmp(magic, SS_LOG_MAGIC, 8) == 0;
+    close(fd);
+    return ok;
+}
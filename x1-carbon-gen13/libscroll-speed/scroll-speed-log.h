@@ -0,0 +1,99 @@
+/*
+ * scroll-speed-log.h — Compact scroll session logs (session-log=DIR)
+ *
+ * The raw libinput values the compositor asked for, in the order it
+ * asked, for building a tuning corpus from daily use.  The engine
+ * thread writes them (ss_log_open … ss_log_close); scroll-replay and
+ * scroll-speed-logdump read them back as a stream (ss_log_reader_*).
+ *
+ * File: SS_LOG_MAGIC, a version byte and the creation time (varint,
+ * Unix seconds), then records.  Each record starts with a tag byte:
+ *
+ *   bits 0-1  source (SS_LOG_FINGER …), or 3 for a control record
+ *   event:    bit 2 horizontal, bit 3 same time as the previous
+ *             record; then unless bit 3 the time delta (varint, µs),
+ *             then the value, zigzag varint: wheels in v120 units
+ *             (exact), finger/continuous in 1/SS_LOG_QUANT units
+ *   control:  bits 2-7 the kind:
+ *             DEVICE   varint vendor, product, width and height (0.1
+ *                      mm), a length byte and the name
+ *             TIME     varint absolute time (µs); starts each file and
+ *                      follows a clock that went backwards
+ *             DROPPED  varint events lost before this point
+ *
+ * A finger event 8 ms after the previous one takes 4-5 bytes, the
+ * other axis of the same event 2-3.  Values are in the units of the
+ * trace format (replay.c): wheels in degrees (v120 / 8).
+ */
+
+#ifndef SCROLL_SPEED_LOG_H
+#define SCROLL_SPEED_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SS_LOG_MAGIC   "SSPEEDLG"   /* 8 bytes, not NUL-terminated */
+#define SS_LOG_VERSION 1
+#define SS_LOG_SUFFIX  ".sslog"
+#define SS_LOG_QUANT   64           /* finger/continuous: 1/64 unit */
+
+enum ss_log_source { SS_LOG_FINGER, SS_LOG_WHEEL, SS_LOG_CONTINUOUS };
+
+struct ss_log_device {
+    unsigned vendor, product;
+    double   width, height;   /* mm; 0 = unknown */
+    char     name[64];
+};
+
+struct ss_log_event {
+    uint64_t time_usec;
+    int      source;          /* enum ss_log_source */
+    int      axis;            /* 0 = vertical, 1 = horizontal */
+    double   value;
+};
+
+/* ── Writer ───────────────────────────────────────────────── */
+
+struct ss_log_writer {
+    FILE    *f;
+    uint64_t time;            /* of the last record */
+    int      have_time;
+    long     bytes;           /* written so far, header included */
+};
+
+/* Create `path` (0600, it must not exist) and write the header; 0 or
+ * -1 (errno set).                                                  */
+int  ss_log_open(struct ss_log_writer *w, const char *path);
+/* Records; 0, or -1 once the file has failed (errno set). */
+int  ss_log_event(struct ss_log_writer *w, const struct ss_log_event *e);
+int  ss_log_device(struct ss_log_writer *w, const struct ss_log_device *d);
+int  ss_log_dropped(struct ss_log_writer *w, uint64_t n);
+/* Flush to the file; 0 or -1. */
+int  ss_log_flush(struct ss_log_writer *w);
+int  ss_log_close(struct ss_log_writer *w);
+
+/* ── Reader ───────────────────────────────────────────────── */
+
+enum { SS_LOG_END = 0, SS_LOG_EVENT = 1, SS_LOG_DEVICE = 2 };
+
+struct ss_log_reader {
+    FILE    *f;
+    int64_t  created;         /* Unix seconds, from the header */
+    uint64_t time;
+    int      have_time;
+    uint64_t dropped;         /* sum of DROPPED records so far */
+    struct ss_log_device device;   /* the last DEVICE record */
+};
+
+/* 0, or -1 with errno set (EINVAL: not a session log). */
+int  ss_log_reader_open(struct ss_log_reader *r, const char *path);
+/* Next record: SS_LOG_EVENT (*e filled), SS_LOG_DEVICE (r->device
+ * updated), SS_LOG_END, or -1 for a corrupt file.  A file cut off
+ * mid-record (still being written, or a crash) ends cleanly.       */
+int  ss_log_next(struct ss_log_reader *r, struct ss_log_event *e);
+void ss_log_reader_close(struct ss_log_reader *r);
+
+/* 1 if `path` starts with SS_LOG_MAGIC */
+int  ss_log_is_log(const char *path);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * scroll-speed-logdump.c — Turn session logs back into text traces
+ *
+ *   scroll-speed-logdump [-s] FILE...
+ *     Reads session logs the compositor wrote with session-log=DIR
+ *     (*.sslog, scroll-speed-log.h) from the start and writes them to
+ *     stdout in replay.c's trace format ("<time_usec> <source> <v|h>
+ *     <value>" and "device ..." lines).  Several files are joined in
+ *     the order given (rotated files sort by name = by time).  The
+ *     output can be used as is with scroll-replay or as a trace in
+ *     traces/.
+ *     -s  no events: per-file statistics instead (events, bytes per
+ *         event, time span, events dropped while logging)
+ *     A file cut off mid-write is read up to there.  A corrupt one has
+ *     the rest of it skipped, and the exit code is 1.
+ *
+ * Build:
+ *   gcc -O2 -o scroll-speed-logdump scroll-speed-logdump.c \
+ *       scroll-speed-log.c -lm
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "scroll-speed-log.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: scroll-speed-logdump [-s] FILE...\n"
+                    "  -s     per-file statistics instead of the events\n");
+}
+
+/* Returns 0, or 1 for an unreadable or corrupt file */
+static int dump(const char *path, int stats)
+{
+    static const char *const source[] = { "finger", "wheel", "continuous" };
+    struct ss_log_reader r;
+    if (ss_log_reader_open(&r, path) < 0) {
+        fprintf(stderr, "%s: %s\n", path, errno == EINVAL
+                ? "not a session log" : strerror(errno));
+        return 1;
+    }
+
+    unsigned long long events = 0, devices = 0;
+    uint64_t first = 0, last = 0;
+    struct ss_log_event e;
+    int rc;
+    if (!stats) {
+        char when[32];
+        time_t created = (time_t)r.created;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S",
+                 localtime(&created));
+        printf("# %s (%s)\n", path, when);
+    }
+    while ((rc = ss_log_next(&r, &e)) > 0) {
+        if (rc == SS_LOG_DEVICE) {
+            devices++;
+            if (!stats)
+                printf("device %04x:%04x %.1f %.1f %s\n", r.device.vendor,
+                       r.device.product, r.device.width, r.device.height,
+                       r.device.name);
+            continue;
+        }
+        if (!events++)
+            first = e.time_usec;
+        last = e.time_usec;
+        if (!stats)
+            printf("%llu %s %c %.9g\n", (unsigned long long)e.time_usec,
+                   source[e.source], e.axis ? 'h' : 'v', e.value);
+    }
+    if (rc < 0)
+        fprintf(stderr, "%s: corrupt after %llu events\n", path, events);
+
+    if (stats) {
+        struct stat st;
+        long long size = fstat(fileno(r.f), &st) == 0 ? st.st_size : 0;
+        printf("%s: %llu events, %llu devices, %lld bytes (%.2f/event), "
+               "%.1f s, %llu dropped\n", path, events, devices, size,
+               events ? (double)size / (double)events : 0.0,
+               (double)(last - first) / 1e6,
+               (unsigned long long)r.dropped);
+    } else if (r.dropped) {
+        printf("# %llu events dropped while logging\n",
+               (unsigned long long)r.dropped);
+    }
+    ss_log_reader_close(&r);
+    return rc < 0;
+}
+
+int main(int argc, char **argv)
+{
+    int stats = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s")) != -1) {
+        switch (opt) {
+        case 's': stats = 1; break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (optind == argc) {
+        usage();
+        return 2;
+    }
+
+    int rc = 0;
+    for (int i = optind; i < argc; i++)
+        rc |= dump(argv[i], stats);
+    return rc;
+}
@@ -0,0 +1,48 @@
+/*
+ * scroll-speed-probes.h — USDT probes for bpftrace, perf and SystemTap
+ *
+ * Built with <sys/sdt.h> (systemtap-sdt-dev / systemtap-sdt-devel),
+ * each probe is a single nop plus an ELF note describing where its
+ * arguments are; nothing runs until a tracer attaches.  Without the
+ * header (or with -DSS_NO_PROBES) they compile to nothing.
+ *
+ * Provider scroll_speed.  In the shim (libscroll-speed.so):
+ *   getter_entry  (event, axis, v120)
+ *   getter_exit   (event, axis, v120, value)
+ * In the engine (libscroll-speed-engine.so):
+ *   transform     (type, axis, v120, raw, out)
+ *   focus_change  (pid, rule, pattern)       rule -1 = no app rule
+ *   config_publish(path, image, edited)      handed to the getters
+ *   config_error  (path, line, message)      line 0 = whole file
+ *
+ * v120 is 1 for the _v120 getter.  Doubles (value, raw, out) are
+ * passed as their IEEE 754 bit pattern in a 64-bit integer: tracers
+ * without floating point (bpftrace) can still decode them, and it
+ * costs at most a register move.  See bpftrace/ for scripts.
+ */
+
+#ifndef SCROLL_SPEED_PROBES_H
+#define SCROLL_SPEED_PROBES_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(SS_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SS_PROBE(name, ...) STAP_PROBEV(scroll_speed, name, __VA_ARGS__)
+#endif
+#endif
+
+#ifndef SS_PROBE
+#define SS_PROBE(name, ...) do { } while (0)
+#endif
+
+static inline uint64_t ss_probe_bits(double v)
+{
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+#endif
@@ -0,0 +1,410 @@
+/*
+ * scroll-speed-shim.c — ABI-stable interposer that hosts the engine
+ *
+ * This is libscroll-speed.so, the library /etc/ld.so.preload loads
+ * (or only gnome-shell, through the systemd drop-in that sets
+ * LD_PRELOAD for it; see gnome-shell-preload.conf).
+ * It interposes the two libinput scroll getters, plus libinput_dispatch
+ * and libinput_get_event (for dequeue-transform=1), and forwards them
+ * to the engine (libscroll-speed-engine.so, see scroll-speed-engine.h).
+ * Because gnome-shell keeps the preloaded library mapped for its
+ * whole life, everything that changes lives in the engine, which the
+ * shim can replace without a re-login:
+ *
+ *   - the engine path is a symlink to a versioned file; `make install`
+ *     points it at a new file, and the shim notices within
+ *     SWAP_CHECK_INTERVAL seconds (its realpath changed);
+ *   - or `scroll-speed-ctl reload-engine` asks for a swap right away.
+ *
+ * Swaps happen on a watcher thread, started with the first getter
+ * call: the new engine is loaded and initialized first (on failure
+ * the old one stays), then published; the old one is unmapped only
+ * once no call is inside it.  The getters themselves only count
+ * themselves in and out, without system calls.
+ * Without a usable engine, everything passes through unchanged.
+ *
+ * Build:
+ *   gcc -shared -fPIC -O2 -fvisibility=hidden -o libscroll-speed.so \
+ *       scroll-speed-shim.c -Wl,--version-script=libscroll-speed.ver
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libinput.h>
+#include "scroll-speed-engine.h"
+#include "scroll-speed-probes.h"
+
+/* ── Version / presence marker (for testing) ──────────────── */
+SS_EXPORT const char *libscroll_speed_version(void) { return "2.2.0"; }
+
+/* ── Engine slots ─────────────────────────────────────────── */
+
+#define ENGINE_NAME         "libscroll-speed-engine.so"
+#define SWAP_CHECK_INTERVAL 3   /* seconds between realpath() checks */
+
+struct engine_slot {
+    void                   *handle;
+    const struct ss_engine *ops;
+    char                    path[PATH_MAX];   /* resolved file */
+};
+
+/* In-flight getter calls, counted per epoch.  A swap publishes the
+ * new engine, flips the epoch and waits for the old epoch's count to
+ * reach zero; the counters are static so a late reader never touches
+ * a freed slot.                                                     */
+static atomic_int g_inflight[2];
+static atomic_int g_epoch;
+
+static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+static atomic_bool    g_init_done;   /* do_init returned: skip the once */
+static _Atomic(struct engine_slot *) g_engine;
+static char      g_engine_link[PATH_MAX];
+static int       g_swap_wake[2] = { -1, -1 };   /* request_swap → watcher */
+static pthread_t g_watcher_tid;
+
+static double (*real_get_scroll_value)(
+    struct libinput_event_pointer *, enum libinput_pointer_axis);
+static double (*real_get_scroll_value_v120)(
+    struct libinput_event_pointer *, enum libinput_pointer_axis);
+
+/* Resolved on first use instead of in do_init: libinput_get_event and
+ * libinput_dispatch run in every process that uses libinput, and must
+ * not be what loads the engine (see below).                        */
+typedef struct libinput_event *(*get_event_fn)(struct libinput *);
+typedef int (*dispatch_fn)(struct libinput *);
+static _Atomic(get_event_fn) real_get_event;
+static _Atomic(dispatch_fn)  real_dispatch;
+
+static void log_line(const char *fmt, const char *a, const char *b)
+{
+    FILE *dbg = fopen("/tmp/scroll-speed-init.log", "a");
+    if (dbg) {
+        fprintf(dbg, fmt, a, b);
+        fputc('\n', dbg);
+        fclose(dbg);
+    }
+}
+
+/* ── Host services ────────────────────────────────────────── */
+
+/* RTLD_NEXT is relative to the caller, so this has to run here in
+ * the shim: the next definition after a preloaded library is the
+ * real libinput one.  The empty asm keeps the call from becoming a
+ * tail jump, which would make the engine the caller.          */
+static void *host_resolve(const char *symbol)
+{
+    void *sym = dlsym(RTLD_NEXT, symbol);
+    __asm__ volatile ("" ::: "memory");
+    return sym;
+}
+
+/* Called from the engine's own thread, which a swap joins: only
+ * wake the watcher, never wait for it.                       */
+static void host_request_swap(void)
+{
+    ssize_t r = write(g_swap_wake[1], "", 1);
+    (void)r;   /* full pipe: a check is pending anyway */
+}
+
+/* The shim is never unloaded, so the engine can hand this to a main
+ * loop that may call it after the engine is gone.               */
+static void host_post_sem(void *sem)
+{
+    sem_post(sem);
+}
+
+static const struct ss_host g_host = {
+    .abi          = SS_ENGINE_ABI,
+    .version      = "2.2.0",
+    .resolve      = host_resolve,
+    .request_swap = host_request_swap,
+    .post_sem     = host_post_sem,
+};
+
+/* ── Load / swap ──────────────────────────────────────────── */
+
+static struct engine_slot *engine_load(const char *path)
+{
+    struct engine_slot *e = calloc(1, sizeof(*e));
+    if (!e)
+        return NULL;
+    snprintf(e->path, sizeof(e->path), "%s", path);
+
+    /* RTLD_LOCAL: the engine's symbols must not interpose anything */
+    e->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    ss_engine_entry_fn entry = e->handle
+        ? (ss_engine_entry_fn)dlsym(e->handle, SS_ENGINE_ENTRY) : NULL;
+    e->ops = entry ? entry() : NULL;
+
+    if (!e->ops || e->ops->abi != SS_ENGINE_ABI || e->ops->init(&g_host) != 0) {
+        log_line("[engine] %s: not loaded (%s)", path,
+                 !e->handle ? dlerror()
+                 : !e->ops  ? "no " SS_ENGINE_ENTRY
+                 : e->ops->abi != SS_ENGINE_ABI ? "ABI mismatch"
+                 : "init failed");
+        if (e->handle)
+            dlclose(e->handle);
+        free(e);
+        return NULL;
+    }
+    log_line("[engine] %s: version %s", path, e->ops->version);
+    return e;
+}
+
+/* Replace the active engine if the link now resolves to another
+ * file.  Only do_init (before the watcher exists) and the watcher
+ * call this; getter calls keep running on whichever engine they
+ * entered.                                                      */
+static void maybe_swap(void)
+{
+    char path[PATH_MAX];
+    if (!realpath(g_engine_link, path))
+        return;   /* engine removed: keep what is loaded */
+
+    struct engine_slot *old = atomic_load(&g_engine);
+    if (old && strcmp(old->path, path) == 0)
+        return;
+
+    struct engine_slot *e = engine_load(path);
+    if (!e)
+        return;
+
+    atomic_store(&g_engine, e);
+    if (old) {
+        /* Drain: calls counted in the old epoch may still be in it */
+        int epoch = atomic_fetch_xor(&g_epoch, 1);
+        while (atomic_load(&g_inflight[epoch]) > 0)
+            sched_yield();
+        if (old->ops->shutdown() == 0)
+            dlclose(old->handle);
+        else
+            log_line("[engine] %s: %s", old->path,
+                     "still in use after shutdown, kept mapped");
+        free(old);
+    }
+    e->ops->start();
+}
+
+/* Check the link every SWAP_CHECK_INTERVAL seconds, or at once on
+ * request_swap */
+static void *swap_watcher(void *arg)
+{
+    (void)arg;
+    struct pollfd pfd = { .fd = g_swap_wake[0], .events = POLLIN };
+    for (;;) {
+        if (poll(&pfd, 1, SWAP_CHECK_INTERVAL * 1000) > 0) {
+            char buf[16];
+            while (read(g_swap_wake[0], buf, sizeof(buf)) > 0)
+                ;
+        }
+        maybe_swap();
+    }
+    return NULL;
+}
+
+static void do_init(void)
+{
+    real_get_scroll_value = dlsym(RTLD_NEXT,
+        "libinput_event_pointer_get_scroll_value");
+    real_get_scroll_value_v120 = dlsym(RTLD_NEXT,
+        "libinput_event_pointer_get_scroll_value_v120");
+
+    /* Default: the engine next to this library (SCROLL_SPEED_ENGINE
+     * overrides; ignored in setuid processes via secure_getenv).   */
+    const char *env = secure_getenv("SCROLL_SPEED_ENGINE");
+    Dl_info info;
+    if (env && *env) {
+        snprintf(g_engine_link, sizeof(g_engine_link), "%s", env);
+    } else if (dladdr((void *)libscroll_speed_version, &info) &&
+               info.dli_fname) {
+        const char *slash = strrchr(info.dli_fname, '/');
+        int dir = slash ? (int)(slash - info.dli_fname) : 1;
+        snprintf(g_engine_link, sizeof(g_engine_link), "%.*s/%s",
+                 dir, slash ? info.dli_fname : ".", ENGINE_NAME);
+    }
+
+    maybe_swap();
+
+    /* The compositor's signal handling stays on its own threads */
+    if (pipe2(g_swap_wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        log_line("[engine] %s: %s", g_engine_link, "no watcher (pipe)");
+        return;
+    }
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    if (pthread_create(&g_watcher_tid, NULL, swap_watcher, NULL) != 0)
+        log_line("[engine] %s: %s", g_engine_link, "no watcher thread");
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static void init_once(void)
+{
+    do_init();
+    atomic_store_explicit(&g_init_done, 1, memory_order_release);
+}
+
+/* Active engine, or NULL, with the call counted in *epoch.  The
+ * count is taken before re-checking the epoch, so a swap either
+ * waits for this call or this call sees the new engine.  Inlined,
+ * and past init a flag test instead of the pthread_once call: that
+ * pays for the probes around it.                                 */
+__attribute__((always_inline))
+static inline struct engine_slot *engine_enter(int *epoch)
+{
+    if (!atomic_load_explicit(&g_init_done, memory_order_acquire))
+        pthread_once(&g_init_once, init_once);
+
+    for (;;) {
+        int i = atomic_load(&g_epoch);
+        atomic_fetch_add(&g_inflight[i], 1);
+        if (atomic_load(&g_epoch) == i) {
+            *epoch = i;
+            return atomic_load(&g_engine);
+        }
+        atomic_fetch_sub(&g_inflight[i], 1);
+    }
+}
+
+static void engine_leave(int epoch)
+{
+    atomic_fetch_sub(&g_inflight[epoch], 1);
+}
+
+/* ── Compositor-scoped preload ────────────────────────────── */
+
+/* With the systemd drop-in (gnome-shell-preload.conf) the shim comes
+ * in through LD_PRELOAD instead of /etc/ld.so.preload.  Drop it from
+ * the environment before main() so that Xwayland and the apps the
+ * shell launches do not inherit it.  Other LD_PRELOAD entries stay. */
+__attribute__((constructor))
+static void scope_preload(void)
+{
+    const char *scope = secure_getenv("SCROLL_SPEED_SCOPE");
+    if (!scope || strcmp(scope, "compositor") != 0)
+        return;
+    unsetenv("SCROLL_SPEED_SCOPE");
+
+    const char *preload = getenv("LD_PRELOAD");
+    if (!preload)
+        return;
+    char kept[4096];
+    size_t n = 0;
+    for (const char *p = preload; *p; ) {
+        size_t len = strcspn(p, ": ");
+        if (len && !memmem(p, len, "libscroll-speed", 15) &&
+            n + len + 1 < sizeof(kept)) {
+            if (n)
+                kept[n++] = ':';
+            memcpy(kept + n, p, len);
+            n += len;
+        }
+        p += len;
+        p += strspn(p, ": ");
+    }
+    kept[n] = '\0';
+    if (n)
+        setenv("LD_PRELOAD", kept, 1);
+    else
+        unsetenv("LD_PRELOAD");
+}
+
+/* ── Interposed functions ─────────────────────────────────── */
+
+SS_EXPORT double libinput_event_pointer_get_scroll_value(
+    struct libinput_event_pointer *event,
+    enum libinput_pointer_axis axis)
+{
+    SS_PROBE(getter_entry, event, axis, 0);
+    int epoch;
+    struct engine_slot *e = engine_enter(&epoch);
+    double v;
+    if (e)
+        v = e->ops->scroll_value(event, axis);
+    else
+        v = real_get_scroll_value ? real_get_scroll_value(event, axis) : 0.0;
+    engine_leave(epoch);
+    SS_PROBE(getter_exit, event, axis, 0, ss_probe_bits(v));
+    return v;
+}
+
+SS_EXPORT double libinput_event_pointer_get_scroll_value_v120(
+    struct libinput_event_pointer *event,
+    enum libinput_pointer_axis axis)
+{
+    SS_PROBE(getter_entry, event, axis, 1);
+    int epoch;
+    struct engine_slot *e = engine_enter(&epoch);
+    double v;
+    if (e)
+        v = e->ops->scroll_value_v120(event, axis);
+    else
+        v = real_get_scroll_value_v120
+            ? real_get_scroll_value_v120(event, axis) : 0.0;
+    engine_leave(epoch);
+    SS_PROBE(getter_exit, event, axis, 1, ss_probe_bits(v));
+    return v;
+}
+
+/* The engine sees every event as it is dequeued, so that with
+ * dequeue-transform=1 the getters above only look the values up.
+ * Until a getter call has brought the engine up these only forward:
+ * a process that dispatches libinput events but never asks for a
+ * scroll value does not load the engine, start its threads or bind
+ * the control socket.                                              */
+SS_EXPORT struct libinput_event *libinput_get_event(struct libinput *libinput)
+{
+    get_event_fn next = atomic_load_explicit(&real_get_event,
+                                             memory_order_relaxed);
+    if (!next) {
+        next = dlsym(RTLD_NEXT, "libinput_get_event");
+        atomic_store_explicit(&real_get_event, next, memory_order_relaxed);
+    }
+    if (!atomic_load_explicit(&g_init_done, memory_order_acquire))
+        return next ? next(libinput) : NULL;
+
+    int epoch;
+    struct engine_slot *e = engine_enter(&epoch);
+    struct libinput_event *event = next ? next(libinput) : NULL;
+    if (e) {
+        if (event)
+            e->ops->dequeued(event);
+        else
+            e->ops->batch();
+    }
+    engine_leave(epoch);
+    return event;
+}
+
+SS_EXPORT int libinput_dispatch(struct libinput *libinput)
+{
+    dispatch_fn next = atomic_load_explicit(&real_dispatch,
+                                            memory_order_relaxed);
+    if (!next) {
+        next = dlsym(RTLD_NEXT, "libinput_dispatch");
+        atomic_store_explicit(&real_dispatch, next, memory_order_relaxed);
+    }
+    if (!atomic_load_explicit(&g_init_done, memory_order_acquire))
+        return next ? next(libinput) : -ENOSYS;
+
+    int epoch;
+    struct engine_slot *e = engine_enter(&epoch);
+    int rc = next ? next(libinput) : -ENOSYS;
+    if (e)
+        e->ops->batch();
+    engine_leave(epoch);
+    return rc;
+}
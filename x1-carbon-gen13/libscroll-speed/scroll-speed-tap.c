@@ -0,0 +1,286 @@
+/*
+ * scroll-speed-tap.c — Live view of scroll values before and after the transform
+ *
+ *   scroll-speed-tap [-f FILE] [-c | -g] [-n COUNT]
+ *     Reads the ring (scroll-speed-tap.h) that the interposer in a
+ *     compositor with event-tap=1 writes to shared memory
+ *     ($XDG_RUNTIME_DIR/scroll-speed-tap by default) and prints, for
+ *     each getter call, libinput's value (raw) and the one returned
+ *     (out).
+ *     -c  CSV (for gnuplot and the like)
+ *     -g  a bar of |out| ('|' marks |raw|)
+ *     -n  exit after COUNT records
+ *     One reader at a time.  The interposer records only while one is
+ *     attached, and drops records when the ring is full (the
+ *     compositor never waits).  The drop count is printed at exit
+ *     (and, in text mode, whenever it grows).  Reattaches when an
+ *     engine swap or an event-tap toggle recreates the ring.
+ *
+ * Build:
+ *   gcc -O2 -o scroll-speed-tap scroll-speed-tap.c -lm
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "scroll-speed-tap.h"
+
+#define POLL_USEC  5000     /* ring empty */
+#define RETRY_USEC 250000   /* no ring (yet) */
+#define PLOT_WIDTH 48       /* columns */
+#define PLOT_SCALE 2.0      /* columns per output unit */
+
+enum { OUT_TEXT, OUT_CSV, OUT_PLOT };
+
+static volatile sig_atomic_t g_quit;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    g_quit = 1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: scroll-speed-tap [-f FILE] [-c | -g] [-n COUNT]\n"
+            "  FILE   tap ring (default $SCROLL_SPEED_TAP or "
+            "$XDG_RUNTIME_DIR/" SS_TAP_NAME ")\n"
+            "  -c     CSV output\n"
+            "  -g     bar plot of |out| ('|' marks |raw|)\n"
+            "  -n     stop after COUNT records\n");
+}
+
+static void sleep_us(long us)
+{
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+/* Map the ring and attach as its reader; NULL (errno set) if there
+ * is none or another reader has it.                              */
+static struct ss_tap *tap_attach(const char *path)
+{
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(struct ss_tap))
+        p = mmap(NULL, sizeof(struct ss_tap), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct ss_tap *t = p;
+    if (memcmp(t->magic, SS_TAP_MAGIC, sizeof(t->magic)) != 0 ||
+        t->version != SS_TAP_VERSION || t->size != sizeof(*t) ||
+        atomic_load(&t->closed) ||
+        (kill(t->producer, 0) != 0 && errno == ESRCH)) {
+        munmap(p, sizeof(*t));
+        errno = ESTALE;
+        return NULL;
+    }
+    int32_t none = 0;
+    if (!atomic_compare_exchange_strong(&t->reader, &none,
+                                        (int32_t)getpid())) {
+        /* A killed reader is released by the compositor shortly */
+        int gone = none < 0 || (kill(none, 0) != 0 && errno == ESRCH);
+        if (!gone)
+            fprintf(stderr, "%s: pid %d is already reading it\n", path,
+                    (int)none);
+        munmap(p, sizeof(*t));
+        errno = gone ? EAGAIN : EBUSY;
+        return NULL;
+    }
+    /* From now on: what came before belonged to nobody */
+    atomic_store_explicit(&t->tail, atomic_load_explicit(
+        &t->head, memory_order_acquire), memory_order_release);
+    return t;
+}
+
+static void tap_detach(struct ss_tap *t)
+{
+    int32_t me = (int32_t)getpid();
+    atomic_compare_exchange_strong(&t->reader, &me, 0);
+    munmap(t, sizeof(*t));
+}
+
+/* Focused process name, cached for the last PID */
+static const char *app_name(int32_t pid)
+{
+    static int32_t last = -1;
+    static char name[64];
+    if (pid <= 0)
+        return "-";
+    if (pid != last) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+        FILE *f = fopen(path, "r");
+        if (!f || !fgets(name, sizeof(name), f))
+            snprintf(name, sizeof(name), "%d", (int)pid);
+        name[strcspn(name, "\n")] = '\0';
+        if (f)
+            fclose(f);
+        last = pid;
+    }
+    return name;
+}
+
+static void print_record(const struct ss_tap_record *r, uint64_t t0,
+                         int mode)
+{
+    static const char *const source[] = {
+        "finger", "wheel", "continuous", "other",
+    };
+    const char *src = source[r->source < 4 ? r->source : 3];
+    char axis = r->flags & SS_TAP_HORIZONTAL ? 'h' : 'v';
+    double t = (double)(r->time_usec - t0) / 1e6;
+
+    if (mode == OUT_CSV) {
+        printf("%llu,%s,%c,%d,%.9g,%.9g,%d,%d,%d\n",
+               (unsigned long long)r->time_usec, src, axis,
+               !!(r->flags & SS_TAP_V120), r->raw, r->out, (int)r->pid,
+               (int)r->rule, !!(r->flags & SS_TAP_PASSTHROUGH));
+        return;
+    }
+    if (mode == OUT_PLOT) {
+        char bar[PLOT_WIDTH + 1];
+        int out = (int)(fabs(r->out) * PLOT_SCALE + 0.5);
+        int raw = (int)(fabs(r->raw) * PLOT_SCALE + 0.5);
+        for (int i = 0; i < PLOT_WIDTH; i++)
+            bar[i] = i == raw ? '|' : i < out ? '#' : ' ';
+        bar[PLOT_WIDTH] = '\0';
+        printf("%9.3f %-10s %c %c%s%s\n", t, src, axis,
+               r->out < 0.0 ? '-' : '+', bar,
+               out > PLOT_WIDTH || raw >= PLOT_WIDTH ? ">" : "");
+        return;
+    }
+    printf("%9.3f %-10s %c%s %9.3f -> %9.3f", t, src, axis,
+           r->flags & SS_TAP_V120 ? "120" : "   ", r->raw, r->out);
+    if (r->raw != 0.0)
+        printf("  x%-6.3f", r->out / r->raw);
+    else
+        printf("  %-7s", "");
+    printf("  %s%s", app_name(r->pid),
+           r->rule >= 0 ? "" : " (no rule)");
+    if (r->flags & SS_TAP_PASSTHROUGH)
+        printf("  [passthrough]");
+    putchar('\n');
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    int mode = OUT_TEXT;
+    long count = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:cgn:")) != -1) {
+        switch (opt) {
+        case 'f': path = optarg; break;
+        case 'c': mode = OUT_CSV; break;
+        case 'g': mode = OUT_PLOT; break;
+        case 'n': count = atol(optarg); break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (optind != argc) {
+        usage();
+        return 2;
+    }
+
+    char buf[4096];
+    if (!path) {
+        const char *env = getenv("SCROLL_SPEED_TAP");
+        const char *dir = getenv("XDG_RUNTIME_DIR");
+        if (env && *env) {
+            path = env;
+        } else if (dir && *dir) {
+            snprintf(buf, sizeof(buf), "%s/%s", dir, SS_TAP_NAME);
+            path = buf;
+        } else {
+            fprintf(stderr, "XDG_RUNTIME_DIR is not set; use -f FILE\n");
+            return 1;
+        }
+    }
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGPIPE, &sa, NULL);
+
+    if (mode == OUT_CSV)
+        printf("time_usec,source,axis,v120,raw,out,pid,rule,passthrough\n");
+
+    unsigned long long records = 0, dropped = 0;
+    uint64_t t0 = 0;
+    int waiting = 0;
+    while (!g_quit && count != 0) {
+        struct ss_tap *t = tap_attach(path);
+        if (!t) {
+            if (errno == EBUSY)
+                return 1;
+            if (!waiting++)
+                fprintf(stderr, "%s: %s; waiting (event-tap=1 in the "
+                        "compositor?)\n", path, strerror(errno));
+            sleep_us(RETRY_USEC);
+            continue;
+        }
+        fprintf(stderr, "%s: attached to pid %d\n", path, (int)t->producer);
+        waiting = 0;
+
+        uint64_t drop0 = atomic_load_explicit(&t->dropped,
+                                              memory_order_relaxed);
+        uint64_t seen_drop = 0;
+        struct ss_tap_record r;
+        long idle = 0;
+        while (!g_quit && count != 0) {
+            if (!ss_tap_pop(t, &r)) {
+                if (atomic_load(&t->closed))
+                    break;   /* re-created: attach to the new one */
+                /* Left behind by a compositor that is gone */
+                if (++idle % (RETRY_USEC / POLL_USEC) == 0 &&
+                    kill(t->producer, 0) != 0 && errno == ESRCH)
+                    break;
+                fflush(stdout);
+                sleep_us(POLL_USEC);
+                continue;
+            }
+            idle = 0;
+            if (!t0)
+                t0 = r.time_usec;
+            print_record(&r, t0, mode);
+            records++;
+            if (count > 0)
+                count--;
+
+            uint64_t d = atomic_load_explicit(&t->dropped,
+                                              memory_order_relaxed) - drop0;
+            if (d != seen_drop && mode == OUT_TEXT)
+                printf("# %llu dropped\n", (unsigned long long)d);
+            seen_drop = d;
+        }
+        dropped += atomic_load_explicit(&t->dropped,
+                                        memory_order_relaxed) - drop0;
+        tap_detach(t);
+        if (!g_quit && count != 0)
+            fprintf(stderr, "%s: closed\n", path);
+    }
+    fflush(stdout);
+    fprintf(stderr, "%llu records, %llu dropped\n", records, dropped);
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * scroll-speed-tap.h — live event tap shared by the engine and readers
+ *
+ * With event-tap=1 the engine thread creates a file in shared memory
+ * ($XDG_RUNTIME_DIR/scroll-speed-tap, or SCROLL_SPEED_TAP) holding a
+ * single-producer/single-consumer ring of the getters' results.  A
+ * reader (scroll-speed-tap) maps it and claims `reader` with its PID;
+ * only then does the engine turn on its getter hook, so with nobody
+ * attached the getters pay nothing.  The engine thread clears `reader`
+ * once that process is gone.
+ *
+ * The producer is the getter (under the engine's input lock), the
+ * consumer the one attached reader.  A full ring drops the record
+ * and counts it in `dropped`: the compositor never waits for a
+ * reader.  `closed` is set when the engine lets go of the ring (tap
+ * turned off, engine swapped or unloaded); the file is unlinked and a
+ * new one, if any, appears under the same path.
+ */
+
+#ifndef SCROLL_SPEED_TAP_H
+#define SCROLL_SPEED_TAP_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define SS_TAP_MAGIC   "SSPEEDTP"   /* 8 bytes, not NUL-terminated */
+#define SS_TAP_VERSION 1
+#define SS_TAP_NAME    "scroll-speed-tap"
+#define SS_TAP_RECORDS 4096         /* power of two */
+
+enum { SS_TAP_FINGER, SS_TAP_WHEEL, SS_TAP_CONTINUOUS, SS_TAP_OTHER };
+
+#define SS_TAP_HORIZONTAL  1u   /* axis */
+#define SS_TAP_V120        2u   /* from the _v120 getter */
+#define SS_TAP_PASSTHROUGH 4u   /* latency-budget passthrough: out = raw */
+
+/* One getter call */
+struct ss_tap_record {
+    uint64_t time_usec;   /* libinput event time (CLOCK_MONOTONIC) */
+    double   raw;         /* what libinput returned */
+    double   out;         /* what the getter returned */
+    int32_t  pid;         /* focused window's process, -1 = unknown */
+    int16_t  rule;        /* its app rule (app-scroll-factor), -1 = none */
+    uint8_t  source;      /* SS_TAP_FINGER … */
+    uint8_t  flags;       /* SS_TAP_HORIZONTAL | … */
+};
+
+struct ss_tap {
+    char     magic[8];
+    uint32_t version;
+    uint32_t size;               /* sizeof(struct ss_tap) */
+    int32_t  producer;           /* compositor PID */
+    _Atomic int32_t  reader;     /* attached reader's PID, 0 = none */
+    _Atomic uint32_t closed;
+    /* Each index on its own cache line: the producer writes head and
+     * dropped, the consumer tail.                                   */
+    _Alignas(64) _Atomic uint64_t head;
+    _Atomic uint64_t dropped;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Alignas(64) struct ss_tap_record rec[SS_TAP_RECORDS];
+};
+
+/* Producer: 0 if the ring was full (the record is dropped) */
+static inline int ss_tap_push(struct ss_tap *t, const struct ss_tap_record *r)
+{
+    uint64_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&t->tail, memory_order_acquire) >=
+        SS_TAP_RECORDS) {
+        atomic_store_explicit(&t->dropped, atomic_load_explicit(
+            &t->dropped, memory_order_relaxed) + 1, memory_order_relaxed);
+        return 0;
+    }
+    t->rec[head % SS_TAP_RECORDS] = *r;
+    atomic_store_explicit(&t->head, head + 1, memory_order_release);
+    return 1;
+}
+
+/* Consumer: 0 if the ring is empty */
+static inline int ss_tap_pop(struct ss_tap *t, struct ss_tap_record *r)
+{
+    uint64_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&t->head, memory_order_acquire))
+        return 0;
+    *r = t->rec[tail % SS_TAP_RECORDS];
+    atomic_store_explicit(&t->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+#endif
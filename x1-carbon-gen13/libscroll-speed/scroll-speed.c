@@ -1,8 +1,10 @@
 /*
- * scroll-speed.c — Non-linear touchpad scroll speed interposer
+ * scroll-speed.c — Non-linear touchpad scroll speed engine
  *
- * LD_PRELOAD library that intercepts libinput scroll value getters
- * and applies a macOS-like non-linear curve:
+ * Transforms libinput scroll values on behalf of the interposer shim
+ * (libscroll-speed.so, scroll-speed-shim.c), which dlopens this file's
+ * library (libscroll-speed-engine.so) and can swap it for a newer
+ * build at run time.  Applies a macOS-like non-linear curve:
  *   - Slow finger movement: nearly 1:1 (precise control)
  *   - Fast finger movement: soft speed cap (tames kinetic scrolling)
  *
@@ -11,148 +13,2360 @@
  *   uses Mutter/GNOME Shell API to detect the focused window's process.
  *   If the focused app matches a known browser (Chrome/Chromium/Electron),
  *   an additional chrome-scroll-factor is applied to compensate for
- *   Chrome's higher internal scroll multiplier.
+ *   Chrome's higher internal scroll multiplier.  app-scroll-factor
+ *   adds rules for other executables.
+ *
+ * Per-monitor scroll factor:
+ *   monitor-scroll-factor rules pick a factor by the monitor under the
+ *   pointer (connector or EDID, optionally at a given scale), looked up
+ *   through Mutter's monitor manager on gnome-shell's main thread.
+ *
+ * Control socket:
+ *   $XDG_RUNTIME_DIR/scroll-speed.sock, served from the engine's
+ *   background thread, lets scroll-speed-ctl get/set parameters of
+ *   the running compositor without editing the config file.
+ *
+ * Event tap:
+ *   With event-tap=1, raw and transformed values go into a shared
+ *   memory ring (scroll-speed-tap.h) while scroll-speed-tap reads it.
+ *
+ * Session log:
+ *   With session-log=DIR, the raw values the compositor reads are
+ *   written to rotating compact files there (scroll-speed-log.h)
+ *   for scroll-replay and scroll-speed-logdump.
+ *
+ * Hot path:
+ *   Once the config is installed, the device seen and the focused
+ *   window unchanged, a getter call makes no system call and no heap
+ *   allocation: reload checks, parsing and freeing all happen on the
+ *   background thread (scroll-replay -z checks this).
  *
  * Build:
- *   gcc -shared -fPIC -O2 -o libscroll-speed.so scroll-speed.c -ldl -lm
+ *   gcc -shared -fPIC -O2 -fvisibility=hidden -o libscroll-speed-engine.so \
+ *       scroll-speed.c scroll-speed-config.c scroll-speed-expr.c \
+ *       scroll-speed-log.c -Wl,--version-script=libscroll-speed-engine.ver -lm
  *
  * Install:
- *   sudo cp libscroll-speed.so /usr/local/lib/x86_64-linux-gnu/
- *   echo '/usr/local/lib/x86_64-linux-gnu/libscroll-speed.so' \
- *        | sudo tee /etc/ld.so.preload
+ *   make install (versioned engine file + libscroll-speed-engine.so
+ *   symlink next to libscroll-speed.so; see the Makefile)
  *
  * Config: /etc/scroll-speed.conf
  */
 
-#define _GNU_SOURCE
-#include <dlfcn.h>
-#include <math.h>
-#include <pthread.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/stat.h>
-#include <time.h>
-#include <unistd.h>
-#include <libinput.h>
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <libinput.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "scroll-speed-config.h"
+#include "scroll-speed-engine.h"
+#include "scroll-speed-log.h"
+#include "scroll-speed-probes.h"
+#include "scroll-speed-tap.h"
+
+#define ENGINE_VERSION "2.2.0"
+
+/* ── Configuration defaults ───────────────────────────────── */
+
+/* All parameters live in one read-only snapshot (struct ss_config,
+ * see scroll-speed-config.h and scroll-speed.conf for the keys).
+ * It is either the compiled image mmap'd from CONF_PATH.bin or a
+ * heap copy parsed from the text config; g_builtin backs it until
+ * a config has been loaded.
+ *
+ * New snapshots are built on the engine thread (file reloads and
+ * control socket edits) and handed over via g_pending; the next
+ * getter call installs it.  Getter calls are serialized by
+ * g_input_lock, so they read g_cfg without further locking.  The
+ * installed snapshot is also published in g_cur, which the engine
+ * thread reads without a lock (active_snapshot).  The replaced one
+ * goes onto g_retired, and only the engine thread releases it, so
+ * the getters never allocate, free or unmap, and a snapshot the
+ * engine thread has loaded stays valid until it next calls
+ * release_retired().                                              */
+struct snapshot {
+    const struct ss_config *cfg;
+    int    mapped;           /* munmap, not free (g_builtin: neither) */
+    int    image;            /* from the compiled image (or edits of it) */
+    int    edited;           /* has control socket edits */
+    unsigned gen;            /* g_config_gen it was installed as */
+    struct snapshot *next;   /* g_retired */
+};
+static struct ss_config g_builtin;
+static struct snapshot g_builtin_snap = { .cfg = &g_builtin };
+static const struct ss_config *g_cfg = &g_builtin;
+static _Atomic(struct snapshot *) g_cur = &g_builtin_snap;   /* g_cfg's */
+static _Atomic(struct snapshot *) g_pending;
+static _Atomic(struct snapshot *) g_retired;
+
+/* libinput normalizes touchpad deltas to a 1000 dpi device */
+#define MM_PER_UNIT 0.0254
+
+/* ── Internal state ───────────────────────────────────────── */
+
+static const struct ss_host *g_host;
+
+/* Held for the whole of each getter call, so that a call sees one
+ * snapshot from start to end and the per-axis state and caches
+ * below change one event at a time.  Only the getters (and
+ * engine_dequeued) take it, and only try it: a call that finds it
+ * taken by another thread's getter passes the event through
+ * untransformed instead of waiting.  Mutter calls the getters from
+ * one thread, where that does not happen; no other thread ever
+ * holds it.  A flag rather than a mutex:
+ * uncontended, it is one xchg and one store instead of two
+ * library calls on every event.                                 */
+static atomic_flag g_input_lock = ATOMIC_FLAG_INIT;
+
+static int input_trylock(void)
+{
+    return !atomic_flag_test_and_set_explicit(&g_input_lock,
+                                              memory_order_acquire);
+}
+
+static void input_unlock(void)
+{
+    atomic_flag_clear_explicit(&g_input_lock, memory_order_release);
+}
+
+/* Real libinput function pointers, resolved through the shim */
+static double (*real_get_scroll_value)(
+    struct libinput_event_pointer *, enum libinput_pointer_axis);
+static double (*real_get_scroll_value_v120)(
+    struct libinput_event_pointer *, enum libinput_pointer_axis);
+static struct libinput_event *(*real_get_base_event)(
+    struct libinput_event_pointer *);
+static enum libinput_event_type (*real_get_type)(
+    struct libinput_event *);
+static uint64_t (*real_get_time_usec)(
+    struct libinput_event_pointer *);
+static struct libinput_event_pointer *(*real_get_pointer_event)(
+    struct libinput_event *);
+static int (*real_has_axis)(
+    struct libinput_event_pointer *, enum libinput_pointer_axis);
+static struct libinput_device *(*real_get_device)(
+    struct libinput_event *);
+static const char *(*real_device_get_name)(struct libinput_device *);
+static unsigned int (*real_device_get_id_vendor)(struct libinput_device *);
+static unsigned int (*real_device_get_id_product)(struct libinput_device *);
+static int (*real_device_get_size)(
+    struct libinput_device *, double *, double *);
+
+/* Mutter / GNOME Shell API function pointers.
+ * Resolved via dlsym(RTLD_DEFAULT) — only available when
+ * loaded into gnome-shell (the compositor process).          */
+static void *(*fn_shell_global_get)(void);
+static void *(*fn_shell_global_get_display)(void *);
+static void *(*fn_meta_display_get_focus_window)(void *);
+static int   (*fn_meta_window_get_pid)(void *);
+
+/* ... and for monitor-scroll-factor, Mutter's monitor manager and
+ * GLib's main loop: meta_display_get_context/meta_context_get_backend
+ * (newer Mutter) or meta_get_backend (older) lead to the manager.  */
+static int   (*fn_meta_display_get_current_monitor)(void *);
+static float (*fn_meta_display_get_monitor_scale)(void *, int);
+static void *(*fn_meta_display_get_context)(void *);
+static void *(*fn_meta_context_get_backend)(void *);
+static void *(*fn_meta_get_backend)(void);
+static void *(*fn_meta_backend_get_monitor_manager)(void *);
+static int   (*fn_meta_monitor_manager_get_monitor_for_connector)(
+    void *, const char *);
+static unsigned (*fn_g_timeout_add_full)(int, unsigned, int (*)(void *),
+                                         void *, void (*)(void *));
+static int   (*fn_g_source_remove)(unsigned);
+
+/* Focused-window app rule cache (index into g_cfg->app_rules, -1 =
+ * none), keyed by PID and invalidated when the config is reloaded. */
+static pid_t    g_cached_focus_pid = -1;
+static unsigned g_cached_focus_gen;
+static int      g_cached_rule = -1;
+
+/* Per-axis gesture state.  A gesture begins with the first non-zero
+ * finger/continuous delta and ends with libinput's zero-valued stop
+ * event, a direction reversal or a pause longer than GESTURE_GAP_USEC.
+ * The history holds the (shaped) output of the current gesture only. */
+#define GESTURE_HISTORY  (SS_STOP_SHAPING_MAX + 1)
+#define GESTURE_GAP_USEC 100000
+#define PREDICT_WINDOW   4
+struct gesture {
+    int      active;
+    uint64_t time[GESTURE_HISTORY];
+    double   out[GESTURE_HISTORY];
+    int      count;      /* valid history entries */
+    int      head;       /* next slot to write */
+    double   lead;       /* look-ahead emitted but not yet clawed back */
+    double   peak;       /* the gesture's fastest |velocity|, units/µs */
+    double   last_raw;   /* dedupe repeated getter calls per event */
+    double   last_emit;
+};
+static struct gesture g_gesture[2];
+
+/* Per-axis wheel acceleration state.  A direction change or a pause
+ * longer than WHEEL_RESET_USEC starts again from the unaccelerated
+ * factor.                                                          */
+#define WHEEL_RESET_USEC 500000
+struct wheel_state {
+    uint64_t time;       /* last detent event; 0 = none */
+    double   interval;   /* smoothed µs per detent; 0 = unknown */
+    int      sign;
+    double   factor;     /* for the other getter on the same event */
+};
+static struct wheel_state g_wheel[2];
+
+/* Per-axis TrackPoint timing for the velocity model */
+struct trackpoint_state {
+    uint64_t time;   /* last event; 0 = none */
+    double   dt;     /* µs since the previous event */
+};
+static struct trackpoint_state g_trackpoint[2];
+
+/* Per-device profile cache, resolved once per libinput_device
+ * pointer.  The device name pointer guards against a removed
+ * device's address being reused; g_config_gen invalidates the
+ * cache when the config is reloaded.                           */
+#define DEVICE_CACHE 16
+struct device_entry {
+    struct libinput_device *device;
+    const char *name;
+    unsigned    gen;
+    int         profile;
+    double      scale;    /* raw delta → profile units */
+};
+static struct device_entry g_devices[DEVICE_CACHE];
+static int      g_device_next;
+static unsigned g_config_gen;
+static int      g_profiles_active;   /* anything beyond the default */
+
+/* Optional getter stages, so that with all of them off the getters
+ * pay a single test and branch.  Written by install_config (under
+ * g_input_lock) and, for HOOK_TAP, by the engine thread; the one
+ * keeps the other's bit with a compare-and-swap.  Read unlocked by
+ * the getters and engine_dequeued().                              */
+#define HOOK_LATENCY 1u   /* latency-stats */
+#define HOOK_DEQUEUE 2u   /* dequeue-transform */
+#define HOOK_BUDGET  4u   /* latency-budget */
+#define HOOK_METRICS 8u   /* metrics-file */
+#define HOOK_TAP     16u  /* event-tap, with a reader attached */
+#define HOOK_SESSION 32u  /* session-log */
+static atomic_uint g_hooks;
+
+/* latency-budget: the getters' budget in cycles of wd_cycles() (0 =
+ * not computed yet, or the counter is not calibrated yet), and
+ * whether they are degraded to passthrough.                       */
+static uint64_t   g_wd_budget;
+static atomic_int g_passthrough;
+
+/* dequeue-transform: values computed in libinput_get_event(), looked
+ * up by the getters.  Every dequeued event overwrites its slot (a
+ * scroll event with its values, anything else with NULL), so a slot
+ * never outlives the event at that address: libinput frees an event
+ * before the memory can come back from another get_event — unless
+ * the dequeue found g_input_lock taken: it then sets g_side_stale,
+ * and the next getter call clears the table before a lookup.
+ * Only touched under g_input_lock.                             */
+#define SIDE_TABLE 16
+struct side_entry {
+    const struct libinput_event_pointer *event;   /* NULL = free */
+    unsigned have;           /* bit (v120 << 1 | axis) */
+    double   value[2][2];    /* [v120][axis] */
+};
+static struct side_entry g_side[SIDE_TABLE];
+static atomic_int g_side_stale;      /* a dequeue could not refill its slot */
+static atomic_int g_batch_new = 1;   /* set by libinput_dispatch & co */
+static double     g_batch_factor;    /* app's and monitor's, for this batch */
+static unsigned   g_batch_gen;       /* g_config_gen it was taken under */
+
+/* metrics-file: counted whether or not it is set.  Reloads on the
+ * engine thread, focus cache misses under g_input_lock; the getter
+ * counters live in the metrics section.                          */
+static atomic_uint      g_mx_reloads[2];      /* [edited]: file, control */
+static atomic_uint      g_mx_reload_errors;   /* invalid file, kept the old */
+static _Atomic uint64_t g_mx_focus_misses;
+
+/* Hot-reload: the engine thread re-reads the config when
+ * /etc/scroll-speed.conf or its compiled image (CONF_PATH.bin)
+ * changes.  SCROLL_SPEED_CONF overrides the path (replay/test
+ * harness only; ignored in setuid processes via secure_getenv).
+ * The mtimes belong to the engine thread once it runs.         */
+#define CONF_PATH "/etc/scroll-speed.conf"
+#define RELOAD_INTERVAL 3  /* seconds between stat() checks */
+static const char *g_conf_path = CONF_PATH;
+static char g_image_path[4096] = CONF_PATH ".bin";
+static time_t g_conf_mtime = 0;
+static time_t g_image_mtime = 0;
+
+/* ── Non-linear transform (Hill function) ─────────────────── */
+
+/* Table lookup with linear interpolation.  Deltas beyond the table
+ * (> 128, practically never seen) evaluate the curve directly.   */
+static double transform(const struct ss_curve *c, double delta)
+{
+    double abs_d = fabs(delta);
+    double x = abs_d * (1.0 / SS_CURVE_TABLE_STEP);
+    double out;
+
+    if (x < SS_CURVE_TABLE_SIZE) {
+        int i = (int)x;
+        out = c->table[i] + (c->table[i + 1] - c->table[i]) * (x - i);
+    } else {
+        out = ss_curve_eval(c, abs_d);
+    }
+
+    return copysign(out, delta);
+}
+
+/* ── Init log ─────────────────────────────────────────────── */
+
+/* Diagnostics for /tmp/scroll-speed-init.log.  Any thread queues a
+ * line — a getter resolving a device, init on the first getter
+ * call, the compositor's main loop — and only the engine thread
+ * opens and appends to the file (log_drain), so none of them waits
+ * for the disk.  Bounded multi-producer queue: a slot's seq says
+ * whether it is free for, or filled at, a given position; seq is
+ * stored minus the slot index so that zeroed slots start out free.
+ * A full queue drops the line and counts it.                    */
+#define LOG_PATH  "/tmp/scroll-speed-init.log"
+#define LOG_LINES 32   /* power of two */
+
+struct log_line {
+    _Atomic uint64_t seq;
+    char text[248];
+};
+
+static struct log_line g_log[LOG_LINES];
+static _Atomic uint64_t g_log_head;      /* producers */
+static _Atomic uint64_t g_log_dropped;   /* producers */
+static uint64_t g_log_tail;              /* engine thread */
+static uint64_t g_log_written_drops;     /* engine thread */
+
+static uint64_t log_seq(struct log_line *l, uint64_t pos)
+{
+    return atomic_load_explicit(&l->seq, memory_order_acquire) +
+           pos % LOG_LINES;
+}
+
+static void log_set_seq(struct log_line *l, uint64_t pos, uint64_t seq)
+{
+    atomic_store_explicit(&l->seq, seq - pos % LOG_LINES,
+                          memory_order_release);
+}
+
+__attribute__((format(printf, 1, 2)))
+static void log_line(const char *fmt, ...)
+{
+    uint64_t pos = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+    struct log_line *l;
+    for (;;) {
+        l = &g_log[pos % LOG_LINES];
+        int64_t dif = (int64_t)(log_seq(l, pos) - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &g_log_head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            atomic_fetch_add_explicit(&g_log_dropped, 1,
+                                      memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+        }
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(l->text, sizeof(l->text), fmt, ap);
+    va_end(ap);
+    log_set_seq(l, pos, pos + 1);
+}
+
+/* Engine thread (or with it gone): append what is queued */
+static void log_drain(void)
+{
+    FILE *f = NULL;
+    int opened = 0;
+    for (;; g_log_tail++) {
+        struct log_line *l = &g_log[g_log_tail % LOG_LINES];
+        if (log_seq(l, g_log_tail) != g_log_tail + 1)
+            break;
+        if (!opened) {
+            f = fopen(LOG_PATH, "a");
+            opened = 1;
+        }
+        if (f)
+            fprintf(f, "%s\n", l->text);
+        log_set_seq(l, g_log_tail, g_log_tail + LOG_LINES);
+    }
+    uint64_t dropped = atomic_load_explicit(&g_log_dropped,
+                                            memory_order_relaxed);
+    if (dropped != g_log_written_drops) {
+        if (!opened)
+            f = fopen(LOG_PATH, "a");
+        if (f)
+            fprintf(f, "[log] %llu lines dropped\n",
+                    (unsigned long long)(dropped - g_log_written_drops));
+        g_log_written_drops = dropped;
+    }
+    if (f)
+        fclose(f);
+}
+
+/* ── Config loading ───────────────────────────────────────── */
+
+static void log_config_error(void *ctx, int line, const char *msg)
+{
+    (void)ctx;
+    SS_PROBE(config_error, g_conf_path, line, msg);
+    if (line)
+        log_line("[config] %s:%d: %s", g_conf_path, line, msg);
+    else
+        log_line("[config] %s: %s", g_conf_path, msg);
+}
+
+/* Map the compiled image read-only.  It is only used while it matches
+ * the text config it was compiled from (or there is no text config),
+ * so editing scroll-speed.conf without recompiling still takes effect. */
+static const struct ss_config *map_image(time_t conf_mtime)
+{
+    int fd = open(g_image_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(struct ss_config))
+        p = mmap(NULL, sizeof(struct ss_config), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    const struct ss_config *c = p;
+    if (ss_config_check_image(c, sizeof(*c)) != 0 ||
+        (conf_mtime && c->source_mtime != (int64_t)conf_mtime)) {
+        munmap(p, sizeof(*c));
+        return NULL;
+    }
+    return c;
+}
+
+/* Invalid lines are skipped, but curves that fail validation (not
+ * finite, negative or decreasing) reject the whole file: returns the
+ * number of such errors.                                         */
+static int parse_text_config(struct ss_config *c)
+{
+    ss_config_defaults(c);
+
+    FILE *f = fopen(g_conf_path, "r");
+    if (f) {
+        ss_config_parse(c, f, log_config_error, NULL);
+        fclose(f);
+    }
+    return ss_config_finish(c, log_config_error, NULL);
+}
+
+/* Wrap a config for publishing (on failure it is released) */
+static struct snapshot *snapshot_new(const struct ss_config *c, int mapped,
+                                     int image, int edited)
+{
+    struct snapshot *s = malloc(sizeof(*s));
+    if (!s) {
+        if (mapped)
+            munmap((void *)c, sizeof(*c));
+        else
+            free((void *)c);
+        return NULL;
+    }
+    s->cfg = c;
+    s->mapped = mapped;
+    s->image = image;
+    s->edited = edited;
+    s->next = NULL;
+    return s;
+}
+
+static void snapshot_release(struct snapshot *s)
+{
+    if (!s || s == &g_builtin_snap)
+        return;
+    if (s->mapped)
+        munmap((void *)s->cfg, sizeof(*s->cfg));
+    else
+        free((void *)s->cfg);
+    free(s);
+}
+
+/* Replace the active snapshot (g_input_lock held, or from init).
+ * The old one is only retired: no other getter call is running,
+ * and the engine thread, which may still be reading it, releases
+ * it later.                                                     */
+static void install_config(struct snapshot *s)
+{
+    struct snapshot *old = atomic_load_explicit(&g_cur, memory_order_relaxed);
+    const struct ss_config *c = s->cfg;
+
+    g_cfg = c;
+    g_profiles_active = c->nprofiles > 1 || c->profiles[0].physical_units ||
+                        c->forced_profile >= 0;
+    unsigned hooks = 0;
+    if (c->latency_stats)
+        hooks |= HOOK_LATENCY;
+    if (c->dequeue_transform && real_get_pointer_event && real_has_axis)
+        hooks |= HOOK_DEQUEUE;
+    if (c->metrics_file[0])
+        hooks |= HOOK_METRICS;
+    if (c->session_log[0])
+        hooks |= HOOK_SESSION;
+    if (c->latency_budget > 0.0)
+        hooks |= HOOK_BUDGET;
+    else
+        atomic_store(&g_passthrough, 0);   /* the watchdog is off */
+    g_wd_budget = 0;                       /* recomputed on the next call */
+    unsigned was = atomic_load_explicit(&g_hooks, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+               &g_hooks, &was, hooks | (was & HOOK_TAP),   /* the engine thread's */
+               memory_order_relaxed, memory_order_relaxed))
+        ;
+    if ((hooks & ~was) & HOOK_DEQUEUE) {
+        memset(g_side, 0, sizeof(g_side));   /* filled while it was off */
+        atomic_store_explicit(&g_batch_new, 1, memory_order_relaxed);
+    }
+    s->gen = ++g_config_gen;
+    atomic_store_explicit(&g_cur, s, memory_order_release);
+
+    if (old != &g_builtin_snap) {
+        old->next = atomic_load(&g_retired);
+        while (!atomic_compare_exchange_weak(&g_retired, &old->next, old))
+            ;
+    }
+}
+
+/* The snapshot the getters are using, for the engine thread.  Only
+ * it frees snapshots, so it may keep using this one until its next
+ * release_retired(); no other thread may use it.                 */
+static const struct snapshot *active_snapshot(void)
+{
+    return atomic_load_explicit(&g_cur, memory_order_acquire);
+}
+
+/* Engine thread: free what the getters have retired */
+static void release_retired(void)
+{
+    struct snapshot *s = atomic_exchange(&g_retired, NULL);
+    while (s) {
+        struct snapshot *next = s->next;
+        snapshot_release(s);
+        s = next;
+    }
+}
+
+/* Hand a snapshot to the next getter call.  It replaces one still
+ * pending, so a file reload drops an unapplied edit made against
+ * the previous file's values.                                   */
+static void publish_config(struct snapshot *s)
+{
+    SS_PROBE(config_publish, g_conf_path, s->image, s->edited);
+    atomic_fetch_add(&g_mx_reloads[s->edited != 0], 1);
+    snapshot_release(atomic_exchange(&g_pending, s));
+}
+
+/* The config as on disk, or NULL to keep the current one */
+static struct snapshot *load_config(void)
+{
+    struct stat st;
+    g_conf_mtime = stat(g_conf_path, &st) == 0 ? st.st_mtime : 0;
+    g_image_mtime = stat(g_image_path, &st) == 0 ? st.st_mtime : 0;
+
+    const struct ss_config *img = map_image(g_conf_mtime);
+    if (img)
+        return snapshot_new(img, 1, 1, 0);
+    if (!g_conf_mtime)
+        return NULL;   /* nothing to load: keep the current snapshot */
+
+    struct ss_config *c = malloc(sizeof(*c));
+    if (!c)
+        return NULL;
+    if (parse_text_config(c) != 0) {
+        log_config_error(NULL, 0, "invalid curve, keeping the previous config");
+        atomic_fetch_add(&g_mx_reload_errors, 1);
+        free(c);
+        return NULL;
+    }
+    return snapshot_new(c, 0, 0, 0);
+}
+
+/* ── Hot-reload ───────────────────────────────────────────── */
+
+/* Engine thread, every RELOAD_INTERVAL seconds */
+static void check_config(void)
+{
+    struct stat st;
+    time_t conf_mtime = stat(g_conf_path, &st) == 0 ? st.st_mtime : 0;
+    time_t image_mtime = stat(g_image_path, &st) == 0 ? st.st_mtime : 0;
+    if (conf_mtime == g_conf_mtime && image_mtime == g_image_mtime)
+        return;
+
+    struct snapshot *s = load_config();
+    if (s)
+        publish_config(s);
+}
+
+/* Getter side: one relaxed load per event */
+static void install_pending(void)
+{
+    if (atomic_load_explicit(&g_pending, memory_order_relaxed)) {
+        struct snapshot *s = atomic_exchange(&g_pending, NULL);
+        if (s)
+            install_config(s);
+    }
+}
+
+/* ── Event latency ────────────────────────────────────────── */
+
+/* With latency-stats=1, the age of each scroll event when its first
+ * getter call runs: CLOCK_MONOTONIC now minus libinput's timestamp,
+ * which is on the same clock.  That is time spent in the kernel,
+ * libinput's queue and Mutter's dispatch before the value was asked
+ * for, none of it ours.  One log2 histogram per source: bucket b
+ * holds ages of b bits (µs), the last one everything from ~1 s up.
+ *
+ * Only getter calls write (under g_input_lock); the engine thread
+ * reads for the stats command with relaxed loads, and "stats reset"
+ * takes a baseline there instead of zeroing under the writer.     */
+#define LAT_BUCKETS 22
+enum { LAT_FINGER, LAT_WHEEL, LAT_CONTINUOUS, LAT_SOURCES };
+struct lat_hist {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;      /* µs */
+    _Atomic uint64_t ahead;    /* timestamp later than now */
+    _Atomic uint64_t bucket[LAT_BUCKETS];
+};
+static struct lat_hist g_latency[LAT_SOURCES];
+static struct libinput_event_pointer *g_lat_event;   /* last sampled */
+static uint64_t g_lat_time;
+/* Engine thread only */
+static uint64_t g_lat_base[LAT_SOURCES][3 + LAT_BUCKETS];
+
+/* Single writer: no read-modify-write instruction needed */
+static void lat_add(_Atomic uint64_t *v, uint64_t n)
+{
+    atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+static void latency_sample(struct libinput_event_pointer *event)
+{
+    if (!real_get_time_usec)
+        return;
+    int src;
+    switch (real_get_type(real_get_base_event(event))) {
+    case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:     src = LAT_FINGER; break;
+    case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:      src = LAT_WHEEL; break;
+    case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: src = LAT_CONTINUOUS; break;
+    default: return;
+    }
+
+    /* Mutter asks once per axis, and for wheels through both getters */
+    uint64_t t = real_get_time_usec(event);
+    if (event == g_lat_event && t == g_lat_time)
+        return;
+    g_lat_event = event;
+    g_lat_time = t;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);   /* vDSO, no system call */
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000u +
+                   (uint64_t)ts.tv_nsec / 1000u;
+    struct lat_hist *h = &g_latency[src];
+    if (t > now) {
+        lat_add(&h->ahead, 1);
+        return;
+    }
+    uint64_t age = now - t;
+    int b = age ? 64 - __builtin_clzll(age) : 0;
+    if (b >= LAT_BUCKETS)
+        b = LAT_BUCKETS - 1;
+    lat_add(&h->bucket[b], 1);
+    lat_add(&h->count, 1);
+    lat_add(&h->sum, age);
+}
+
+/* Counters since the last reset: count, sum, ahead, buckets */
+static void latency_read(int src, uint64_t v[3 + LAT_BUCKETS])
+{
+    const struct lat_hist *h = &g_latency[src];
+    v[0] = atomic_load_explicit(&h->count, memory_order_relaxed);
+    v[1] = atomic_load_explicit(&h->sum, memory_order_relaxed);
+    v[2] = atomic_load_explicit(&h->ahead, memory_order_relaxed);
+    for (int b = 0; b < LAT_BUCKETS; b++)
+        v[3 + b] = atomic_load_explicit(&h->bucket[b], memory_order_relaxed);
+    for (int i = 0; i < 3 + LAT_BUCKETS; i++)
+        v[i] -= g_lat_base[src][i];
+}
+
+static void latency_reset(void)
+{
+    for (int src = 0; src < LAT_SOURCES; src++) {
+        uint64_t v[3 + LAT_BUCKETS];
+        latency_read(src, v);
+        for (int i = 0; i < 3 + LAT_BUCKETS; i++)
+            g_lat_base[src][i] += v[i];
+    }
+}
+
+/* Upper bound (µs) of the bucket holding quantile q, -1 = open */
+static long latency_quantile(const uint64_t v[3 + LAT_BUCKETS], double q)
+{
+    uint64_t want = (uint64_t)ceil(q * (double)v[0]), seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += v[3 + b];
+        if (seen >= want && seen)
+            return b == LAT_BUCKETS - 1 ? -1 : 1L << b;
+    }
+    return -1;
+}
+
+static void latency_report(const struct ss_config *c, FILE *out)
+{
+    static const char *const name[LAT_SOURCES] = {
+        "finger", "wheel", "continuous",
+    };
+    uint64_t v[LAT_SOURCES][3 + LAT_BUCKETS];
+    for (int src = 0; src < LAT_SOURCES; src++)
+        latency_read(src, v[src]);
+
+    fprintf(out, "# event age at the first getter call (CLOCK_MONOTONIC - "
+            "event time), us; latency-stats=%d\n", c->latency_stats);
+    fprintf(out, "%-10s %9s %9s %9s %9s %9s %9s %7s\n", "source", "events",
+            "mean", "p50<", "p90<", "p99<", "max<", "ahead");
+    for (int src = 0; src < LAT_SOURCES; src++) {
+        const uint64_t *s = v[src];
+        fprintf(out, "%-10s %9llu %9.1f", name[src], (unsigned long long)s[0],
+                s[0] ? (double)s[1] / (double)s[0] : 0.0);
+        static const double q[] = { 0.5, 0.9, 0.99, 1.0 };
+        for (int i = 0; i < 4; i++) {
+            long ub = latency_quantile(s, q[i]);
+            if (!s[0])
+                fprintf(out, " %9s", "-");
+            else if (ub < 0)
+                fprintf(out, " %9s", "inf");
+            else
+                fprintf(out, " %9ld", ub);
+        }
+        fprintf(out, " %7llu\n", (unsigned long long)s[2]);
+    }
+
+    /* Histogram rows from the first to the last non-empty bucket */
+    int lo = LAT_BUCKETS, hi = -1;
+    for (int b = 0; b < LAT_BUCKETS; b++)
+        for (int src = 0; src < LAT_SOURCES; src++)
+            if (v[src][3 + b]) {
+                if (b < lo)
+                    lo = b;
+                hi = b;
+            }
+    if (hi < 0)
+        return;
+    fprintf(out, "\n%-10s %9s %9s %9s\n", "age <", name[0], name[1], name[2]);
+    for (int b = lo; b <= hi; b++) {
+        char label[16];
+        if (b == LAT_BUCKETS - 1)
+            snprintf(label, sizeof(label), "inf");
+        else
+            snprintf(label, sizeof(label), "%ld", 1L << b);
+        fprintf(out, "%-10s", label);
+        for (int src = 0; src < LAT_SOURCES; src++)
+            fprintf(out, " %9llu", (unsigned long long)v[src][3 + b]);
+        fputc('\n', out);
+    }
+}
+
+/* ── Latency budget (latency-budget=µs) ───────────────────── */
+
+/* With latency-budget > 0 every getter call, and every dequeue-time
+ * transform, is timed with the CPU's cycle counter from entry (the
+ * try of the input lock included; it never waits).
+ * latency-budget-overruns calls over budget
+ * within WD_WINDOW calls switch the getters to passthrough: the raw
+ * libinput value, without focus lookup, profile matching or anything
+ * else that could block the compositor's input path.
+ *
+ * The engine thread then probes, every WD_PROBE_MS, the system
+ * calls a getter or the engine can get stuck on: readlink() of the
+ * /proc/PID/exe of the app focused at the trip, and stat() of the
+ * config, followed by the transform itself.  It stops at the first
+ * step past the budget.  Once the whole probe fits in the budget
+ * again, full processing comes back; a relapse within WD_STABLE_SEC
+ * doubles the probe interval, up to WD_PROBE_MAX_MS.  The focus
+ * lookup through Mutter belongs to the main thread and is not
+ * probed: if it still stalls, the getters trip again.  Every
+ * transition goes to a log that the stats command prints.       */
+#define WD_WINDOW       256     /* calls */
+#define WD_LOG          16      /* transitions kept */
+#define WD_PROBE_MS     1000
+#define WD_PROBE_MAX_MS 60000
+#define WD_STABLE_SEC   30
+
+static inline uint64_t wd_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ volatile ("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static _Atomic double g_cycles_per_us;   /* 0 until calibrated */
+
+/* Getter side, under g_input_lock */
+static unsigned g_wd_calls, g_wd_strikes;
+static uint64_t g_wd_worst;               /* cycles, this window */
+/* Written by the getters, read by the engine thread */
+static _Atomic uint64_t g_wd_over;        /* calls over budget */
+static _Atomic uint64_t g_wd_raw;         /* answered in passthrough */
+static atomic_uint      g_wd_trips;
+static _Atomic double   g_wd_trip_worst;  /* µs */
+static _Atomic long     g_wd_trip_time;   /* CLOCK_REALTIME */
+static atomic_int       g_wd_trip_pid;    /* focused app, -1 = none */
+
+/* Engine thread only */
+struct wd_record {
+    time_t time;
+    int    passthrough;   /* the state entered */
+    char   detail[96];
+};
+static struct wd_record g_wd_log[WD_LOG];
+static unsigned g_wd_logged;              /* records ever written */
+static unsigned g_wd_seen_trips;
+static int      g_wd_state;               /* as logged */
+static long     g_wd_probe_ms = WD_PROBE_MS;
+static long     g_wd_next_probe;          /* CLOCK_MONOTONIC ms, 0 = unset */
+static time_t   g_wd_recovered;           /* CLOCK_REALTIME s, like trips */
+static unsigned g_wd_probes;              /* failed, since the trip */
+static uint64_t g_wd_base[2];             /* stats reset: over, raw */
+
+/* A getter call that started at t0 ends now (g_input_lock held) */
+static void wd_account(uint64_t t0)
+{
+    uint64_t dt = wd_cycles() - t0;
+    if (!g_wd_budget) {
+        g_wd_budget = (uint64_t)(g_cfg->latency_budget *
+            atomic_load_explicit(&g_cycles_per_us, memory_order_relaxed));
+        if (!g_wd_budget)
+            return;
+    }
+    if (++g_wd_calls >= WD_WINDOW) {
+        g_wd_calls = 0;
+        g_wd_strikes = 0;
+        g_wd_worst = 0;
+    }
+    if (dt <= g_wd_budget)
+        return;
+    lat_add(&g_wd_over, 1);
+    if (dt > g_wd_worst)
+        g_wd_worst = dt;
+    if (++g_wd_strikes < (unsigned)g_cfg->latency_budget_overruns)
+        return;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);   /* vDSO, no system call */
+    atomic_store_explicit(&g_wd_trip_time, (long)ts.tv_sec,
+                          memory_order_relaxed);
+    atomic_store_explicit(&g_wd_trip_worst, (double)g_wd_worst /
+        atomic_load_explicit(&g_cycles_per_us, memory_order_relaxed),
+        memory_order_relaxed);
+    atomic_store_explicit(&g_wd_trip_pid, g_cached_focus_pid,
+                          memory_order_relaxed);
+    g_wd_calls = g_wd_strikes = 0;
+    g_wd_worst = 0;
+    atomic_store(&g_passthrough, 1);
+    atomic_fetch_add(&g_wd_trips, 1);
+}
+
+/* Cycle counter ticks per µs, against CLOCK_MONOTONIC; at the start
+ * of the engine thread (a 20 ms sleep on x86)                      */
+static void wd_calibrate(void)
+{
+    double cpu;
+#if defined(__x86_64__) || defined(__i386__)
+    struct timespec a, b, nap = { 0, 20 * 1000000 };
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    uint64_t c0 = wd_cycles();
+    nanosleep(&nap, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    uint64_t c1 = wd_cycles();
+    double us = (double)(b.tv_sec - a.tv_sec) * 1e6 +
+                (double)(b.tv_nsec - a.tv_nsec) / 1e3;
+    cpu = us > 0.0 ? (double)(c1 - c0) / us : 0.0;
+#elif defined(__aarch64__)
+    uint64_t hz;
+    __asm__ volatile ("mrs %0, cntfrq_el0" : "=r"(hz));
+    cpu = (double)hz / 1e6;
+#else
+    cpu = 1000.0;   /* wd_cycles() is in ns */
+#endif
+    atomic_store_explicit(&g_cycles_per_us, cpu, memory_order_relaxed);
+}
+
+/* A new transition; the caller fills in the detail */
+static char *wd_log(time_t when, int passthrough)
+{
+    struct wd_record *r = &g_wd_log[g_wd_logged++ % WD_LOG];
+    r->time = when;
+    r->passthrough = passthrough;
+    g_wd_state = passthrough;
+    return r->detail;
+}
+
+/* Log what the getters did since the last call (engine thread) */
+static void wd_sync(const struct ss_config *c)
+{
+    unsigned trips = atomic_load(&g_wd_trips);
+    if (trips != g_wd_seen_trips) {
+        g_wd_seen_trips = trips;
+        time_t when = (time_t)atomic_load_explicit(&g_wd_trip_time,
+                                                   memory_order_relaxed);
+        snprintf(wd_log(when, 1), sizeof(g_wd_log[0].detail),
+                 "%d calls over %.0f us in %d, worst %.1f us, focus pid %d",
+                 c->latency_budget_overruns, c->latency_budget, WD_WINDOW,
+                 atomic_load_explicit(&g_wd_trip_worst, memory_order_relaxed),
+                 atomic_load_explicit(&g_wd_trip_pid, memory_order_relaxed));
+        /* A relapse soon after recovering: probe less often */
+        if (g_wd_recovered && when - g_wd_recovered < WD_STABLE_SEC)
+            g_wd_probe_ms = g_wd_probe_ms * 2 < WD_PROBE_MAX_MS
+                ? g_wd_probe_ms * 2 : WD_PROBE_MAX_MS;
+        else
+            g_wd_probe_ms = WD_PROBE_MS;
+        g_wd_next_probe = 0;
+        g_wd_probes = 0;
+    }
+    if (g_wd_state && !atomic_load(&g_passthrough))
+        snprintf(wd_log(time(NULL), 0), sizeof(g_wd_log[0].detail),
+                 "latency-budget=0");
+}
+
+/* One probe (see above); µs from the first step to the last one
+ * run, which is the first to end past `budget` µs.              */
+static double wd_probe(const struct ss_config *c, double budget)
+{
+    static const double deltas[] = { 0.5, 4.0, 25.0, 200.0 };   /* 200: past the table */
+    double cpu = atomic_load_explicit(&g_cycles_per_us, memory_order_relaxed);
+    if (cpu <= 0.0)
+        return 0.0;
+    uint64_t deadline = (uint64_t)(budget * cpu);
+    uint64_t t0 = wd_cycles();
+
+    /* Failures count as they are: the time is what is measured */
+    int pid = atomic_load_explicit(&g_wd_trip_pid, memory_order_relaxed);
+    if (pid > 0) {
+        char path[64], exe[256];
+        snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+        ssize_t n = readlink(path, exe, sizeof(exe));
+        (void)n;
+        uint64_t dt = wd_cycles() - t0;
+        if (dt > deadline)
+            return (double)dt / cpu;
+    }
+    struct stat st;
+    (void)stat(g_conf_path, &st);
+    uint64_t dt = wd_cycles() - t0;
+    if (dt > deadline)
+        return (double)dt / cpu;
+
+    volatile double sink = 0.0;
+    for (size_t i = 0; i < sizeof(deltas) / sizeof(deltas[0]); i++) {
+        sink += transform(&c->profiles[0].finger, deltas[i]);
+        sink += transform(&c->profiles[0].trackpoint, deltas[i]);
+    }
+    (void)sink;
+    return (double)(wd_cycles() - t0) / cpu;
+}
+
+/* Engine thread, every loop: log, probe if due.  Returns the poll
+ * timeout (ms): with the watchdog on, WD_PROBE_MS or until the next
+ * probe, so a trip is noticed soon; at most RELOAD_INTERVAL s.     */
+static int wd_tick(void)
+{
+    const struct ss_config *c = active_snapshot()->cfg;
+    wd_sync(c);
+    double budget = c->latency_budget;
+    if (!g_wd_state)
+        return budget > 0.0 ? WD_PROBE_MS : RELOAD_INTERVAL * 1000;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long now_ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    if (!g_wd_next_probe)
+        g_wd_next_probe = now_ms + g_wd_probe_ms;
+    if (now_ms < g_wd_next_probe) {
+        long wait = g_wd_next_probe - now_ms;
+        return wait < RELOAD_INTERVAL * 1000 ? (int)wait
+                                             : RELOAD_INTERVAL * 1000;
+    }
+
+    double us = wd_probe(c, budget);
+    if (us > budget) {
+        g_wd_probes++;
+        g_wd_next_probe = now_ms + g_wd_probe_ms;
+        return g_wd_probe_ms < RELOAD_INTERVAL * 1000
+            ? (int)g_wd_probe_ms : RELOAD_INTERVAL * 1000;
+    }
+    atomic_store(&g_passthrough, 0);
+    g_wd_recovered = time(NULL);
+    snprintf(wd_log(g_wd_recovered, 0), sizeof(g_wd_log[0].detail),
+             "probe %.1f us after %u failed, interval %ld ms",
+             us, g_wd_probes, g_wd_probe_ms);
+    return RELOAD_INTERVAL * 1000;
+}
+
+static void wd_report(const struct ss_config *c, FILE *out)
+{
+    wd_sync(c);
+    uint64_t over = atomic_load(&g_wd_over) - g_wd_base[0];
+    uint64_t raw = atomic_load(&g_wd_raw) - g_wd_base[1];
+    fprintf(out, "\n# latency budget: %.0f us per call, passthrough after "
+            "%d over in %d calls; state %s\n", c->latency_budget,
+            c->latency_budget_overruns, WD_WINDOW,
+            c->latency_budget <= 0.0 ? "off"
+            : atomic_load(&g_passthrough) ? "passthrough" : "full");
+    fprintf(out, "# over budget %llu, passthrough calls %llu, cycle counter "
+            "%.1f/us\n", (unsigned long long)over, (unsigned long long)raw,
+            atomic_load_explicit(&g_cycles_per_us, memory_order_relaxed));
+    unsigned n = g_wd_logged < WD_LOG ? g_wd_logged : WD_LOG;
+    for (unsigned i = g_wd_logged - n; i < g_wd_logged; i++) {
+        const struct wd_record *r = &g_wd_log[i % WD_LOG];
+        struct tm tm;
+        char when[32];
+        localtime_r(&r->time, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+        fprintf(out, "%s  %-11s  %s\n", when,
+                r->passthrough ? "passthrough" : "full", r->detail);
+    }
+}
+
+static void wd_reset(void)
+{
+    g_wd_base[0] = atomic_load(&g_wd_over);
+    g_wd_base[1] = atomic_load(&g_wd_raw);
+    g_wd_logged = 0;
+}
+
+/* ── Metrics export (metrics-file=PATH) ───────────────────── */
+
+/* With metrics-file set, the engine thread writes counters for
+ * node_exporter's textfile collector every metrics-interval seconds:
+ * to a temporary file next to it, renamed over it, so a scrape never
+ * sees half a file.  The getters only count, under g_input_lock:
+ * calls per getter and their duration (input lock included) in log2
+ * buckets from MX_BUCKET0_NS.  Counters start from zero with each
+ * engine, which Prometheus treats as a counter reset.            */
+#define MX_BUCKETS    16
+#define MX_BUCKET0_NS 250
+
+struct mx_getter {
+    _Atomic uint64_t calls;
+    _Atomic uint64_t cycles;                  /* sum, once calibrated */
+    _Atomic uint64_t bucket[MX_BUCKETS + 1];  /* the last one is +Inf */
+};
+static struct mx_getter g_mx_getter[2];       /* [v120] */
+static _Atomic uint64_t g_mx_unit;            /* cycles per MX_BUCKET0_NS */
+
+/* Engine thread only */
+static long g_mx_next;                        /* CLOCK_MONOTONIC ms */
+static char g_mx_path[SS_MAX_PATH];           /* last written */
+static int  g_mx_failed;                      /* logged, until one works */
+
+/* A getter call that started at t0 ends now (g_input_lock held) */
+static void mx_account(int v120, uint64_t t0)
+{
+    struct mx_getter *g = &g_mx_getter[v120];
+    lat_add(&g->calls, 1);
+    uint64_t unit = atomic_load_explicit(&g_mx_unit, memory_order_relaxed);
+    if (!unit)
+        return;
+    uint64_t dt = wd_cycles() - t0;
+    uint64_t q = dt / unit;
+    int b = q ? 64 - __builtin_clzll(q) : 0;
+    if (b > MX_BUCKETS)
+        b = MX_BUCKETS;
+    lat_add(&g->bucket[b], 1);
+    lat_add(&g->cycles, dt);
+}
+
+/* What the file shows of the active config */
+struct mx_config {
+    uint64_t checksum;
+    int      image, edited;
+    int      latency_stats;
+    double   latency_budget;
+};
+
+static void mx_print(FILE *f, const struct mx_config *mc)
+{
+    static const char *const getter[2] = { "scroll_value", "scroll_value_v120" };
+    double cpu = atomic_load_explicit(&g_cycles_per_us, memory_order_relaxed);
+
+    fputs("# HELP scroll_speed_getter_calls_total Interposed libinput "
+          "getter calls.\n"
+          "# TYPE scroll_speed_getter_calls_total counter\n", f);
+    for (int i = 0; i < 2; i++)
+        fprintf(f, "scroll_speed_getter_calls_total{getter=\"%s\"} %llu\n",
+                getter[i], (unsigned long long)atomic_load_explicit(
+                    &g_mx_getter[i].calls, memory_order_relaxed));
+
+    fputs("# HELP scroll_speed_getter_duration_seconds Getter call "
+          "duration, taking the input lock included.\n"
+          "# TYPE scroll_speed_getter_duration_seconds histogram\n", f);
+    for (int i = 0; i < 2; i++) {
+        const struct mx_getter *g = &g_mx_getter[i];
+        uint64_t seen = 0;
+        for (int b = 0; b <= MX_BUCKETS; b++) {
+            seen += atomic_load_explicit(&g->bucket[b], memory_order_relaxed);
+            if (b < MX_BUCKETS)
+                fprintf(f, "scroll_speed_getter_duration_seconds_bucket"
+                        "{getter=\"%s\",le=\"%g\"} %llu\n", getter[i],
+                        MX_BUCKET0_NS * 1e-9 * (double)(1u << b),
+                        (unsigned long long)seen);
+            else
+                fprintf(f, "scroll_speed_getter_duration_seconds_bucket"
+                        "{getter=\"%s\",le=\"+Inf\"} %llu\n", getter[i],
+                        (unsigned long long)seen);
+        }
+        double cycles = (double)atomic_load_explicit(&g->cycles,
+                                                     memory_order_relaxed);
+        fprintf(f, "scroll_speed_getter_duration_seconds_sum{getter=\"%s\"} "
+                "%.9f\n", getter[i], cpu > 0.0 ? cycles / cpu / 1e6 : 0.0);
+        fprintf(f, "scroll_speed_getter_duration_seconds_count"
+                "{getter=\"%s\"} %llu\n", getter[i], (unsigned long long)seen);
+    }
+
+    /* Events (not calls) per source: only latency-stats counts them */
+    if (mc->latency_stats) {
+        static const char *const source[LAT_SOURCES] = {
+            "finger", "wheel", "continuous",
+        };
+        fputs("# HELP scroll_speed_events_total Scroll events seen by the "
+              "getters (latency-stats=1).\n"
+              "# TYPE scroll_speed_events_total counter\n", f);
+        for (int src = 0; src < LAT_SOURCES; src++) {
+            const struct lat_hist *h = &g_latency[src];
+            fprintf(f, "scroll_speed_events_total{source=\"%s\"} %llu\n",
+                    source[src], (unsigned long long)(
+                    atomic_load_explicit(&h->count, memory_order_relaxed) +
+                    atomic_load_explicit(&h->ahead, memory_order_relaxed)));
+        }
+    }
+
+    fprintf(f, "# HELP scroll_speed_config_reloads_total Config snapshots "
+            "published.\n"
+            "# TYPE scroll_speed_config_reloads_total counter\n"
+            "scroll_speed_config_reloads_total{source=\"file\"} %u\n"
+            "scroll_speed_config_reloads_total{source=\"control\"} %u\n"
+            "# HELP scroll_speed_config_reload_errors_total Config files "
+            "rejected, the previous config kept.\n"
+            "# TYPE scroll_speed_config_reload_errors_total counter\n"
+            "scroll_speed_config_reload_errors_total %u\n",
+            atomic_load(&g_mx_reloads[0]), atomic_load(&g_mx_reloads[1]),
+            atomic_load(&g_mx_reload_errors));
+    fprintf(f, "# HELP scroll_speed_focus_cache_misses_total Focused-app "
+            "lookups that read /proc (new PID or config).\n"
+            "# TYPE scroll_speed_focus_cache_misses_total counter\n"
+            "scroll_speed_focus_cache_misses_total %llu\n",
+            (unsigned long long)atomic_load_explicit(&g_mx_focus_misses,
+                                                     memory_order_relaxed));
+    fprintf(f, "# HELP scroll_speed_watchdog_trips_total Switches to "
+            "passthrough (latency-budget).\n"
+            "# TYPE scroll_speed_watchdog_trips_total counter\n"
+            "scroll_speed_watchdog_trips_total %u\n"
+            "# HELP scroll_speed_passthrough 1 while the getters pass "
+            "values through.\n"
+            "# TYPE scroll_speed_passthrough gauge\n"
+            "scroll_speed_passthrough %d\n",
+            atomic_load(&g_wd_trips),
+            mc->latency_budget > 0.0 && atomic_load(&g_passthrough));
+    fprintf(f, "# HELP scroll_speed_config_info The active config "
+            "(checksum of its image).\n"
+            "# TYPE scroll_speed_config_info gauge\n"
+            "scroll_speed_config_info{checksum=\"%016llx\",source=\"%s\","
+            "edited=\"%d\",engine=\"" ENGINE_VERSION "\"} 1\n",
+            (unsigned long long)mc->checksum,
+            mc->image ? "image" : "text", mc->edited);
+}
+
+/* Write `path` through a temporary file and rename; 0 = done */
+static int mx_write(const char *path, const struct mx_config *mc)
+{
+    char tmp[SS_MAX_PATH + 32];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *f = fopen(tmp, "w");
+    if (!f)
+        return -1;
+    mx_print(f, mc);
+    int bad = ferror(f);
+    if (fclose(f) != 0 || bad || rename(tmp, path) != 0) {
+        int err = errno;
+        unlink(tmp);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* Engine thread, every loop: write the file if due, remove the old
+ * one when metrics-file changes.  Returns the poll timeout (ms)
+ * until the next write, at most RELOAD_INTERVAL s.               */
+static int mx_tick(void)
+{
+    double cpu = atomic_load_explicit(&g_cycles_per_us, memory_order_relaxed);
+    if (!atomic_load_explicit(&g_mx_unit, memory_order_relaxed) && cpu > 0.0)
+        atomic_store_explicit(&g_mx_unit,
+                              (uint64_t)(cpu * MX_BUCKET0_NS / 1000.0) + 1,
+                              memory_order_relaxed);
+
+    char path[SS_MAX_PATH];
+    struct mx_config mc;
+    const struct snapshot *snap = active_snapshot();
+    const struct ss_config *c = snap->cfg;
+    snprintf(path, sizeof(path), "%s", c->metrics_file);
+    long interval_ms = c->metrics_interval * 1000L;
+    mc.checksum = c->checksum;
+    mc.image = snap->image;
+    mc.edited = snap->edited;
+    mc.latency_stats = c->latency_stats;
+    mc.latency_budget = c->latency_budget;
+
+    if (strcmp(path, g_mx_path) != 0) {
+        if (g_mx_path[0])
+            unlink(g_mx_path);   /* no stale numbers under the old name */
+        snprintf(g_mx_path, sizeof(g_mx_path), "%s", path);
+        g_mx_next = 0;
+        g_mx_failed = 0;
+    }
+    if (!path[0])
+        return RELOAD_INTERVAL * 1000;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long now_ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    if (now_ms >= g_mx_next) {
+        g_mx_next = now_ms + interval_ms;
+        if (mx_write(path, &mc) == 0) {
+            g_mx_failed = 0;
+        } else if (!g_mx_failed) {
+            g_mx_failed = 1;
+            log_line("[metrics] %s: %s", path, strerror(errno));
+        }
+    }
+    long wait = g_mx_next - now_ms;
+    return wait < RELOAD_INTERVAL * 1000 ? (int)wait : RELOAD_INTERVAL * 1000;
+}
+
+/* ── Event tap (event-tap=1) ──────────────────────────────── */
+
+/* The ring (scroll-speed-tap.h) is created and removed by the
+ * engine thread, which also watches for a reader: HOOK_TAP is on
+ * only while one is attached.  The getters push through g_tap,
+ * counted in g_tap_inflight for the epoch they started in, as the
+ * shim counts engine calls: the engine thread clears g_tap, flips
+ * the epoch and waits for the old one to drain before unmapping,
+ * without ever taking the getters' lock.                         */
+#define TAP_CHECK_MS 250   /* reader attach/exit checks */
+
+static _Atomic(struct ss_tap *) g_tap;   /* getters */
+static atomic_int g_tap_inflight[2];
+static atomic_int g_tap_epoch;
+/* Engine thread only */
+static struct ss_tap *g_tap_map;
+static char g_tap_path[4096];
+static int  g_tap_failed;      /* logged, until event-tap is turned off */
+
+static void tap_push(struct ss_tap *t, struct libinput_event_pointer *event,
+                     int v120, enum libinput_pointer_axis axis, double out,
+                     int passthrough)
+{
+    struct ss_tap_record r;
+    r.time_usec = real_get_time_usec ? real_get_time_usec(event) : 0;
+    r.raw = v120 ? real_get_scroll_value_v120(event, axis)
+                 : real_get_scroll_value(event, axis);
+    r.out = out;
+    switch (real_get_type(real_get_base_event(event))) {
+    case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:     r.source = SS_TAP_FINGER; break;
+    case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:      r.source = SS_TAP_WHEEL; break;
+    case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: r.source = SS_TAP_CONTINUOUS; break;
+    default:                                       r.source = SS_TAP_OTHER; break;
+    }
+    r.flags = (axis == LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL ?
+               SS_TAP_HORIZONTAL : 0) | (v120 ? SS_TAP_V120 : 0) |
+              (passthrough ? SS_TAP_PASSTHROUGH : 0);
+    /* As of the last lookup; with no app rules there is none */
+    int fresh = g_cached_focus_gen == g_config_gen;
+    r.pid = fresh ? g_cached_focus_pid : -1;
+    r.rule = (int16_t)(fresh ? g_cached_rule : -1);
+    ss_tap_push(t, &r);
+}
+
+/* A getter call returned `out` (g_input_lock held) */
+static void tap_record(struct libinput_event_pointer *event, int v120,
+                       enum libinput_pointer_axis axis, double out,
+                       int passthrough)
+{
+    int epoch = atomic_load(&g_tap_epoch);
+    atomic_fetch_add(&g_tap_inflight[epoch], 1);
+    struct ss_tap *t = atomic_load(&g_tap);
+    if (t)
+        tap_push(t, event, v120, axis, out, passthrough);
+    atomic_fetch_sub(&g_tap_inflight[epoch], 1);
+}
+
+static void tap_hook(int on)
+{
+    if (on)
+        atomic_fetch_or(&g_hooks, HOOK_TAP);
+    else
+        atomic_fetch_and(&g_hooks, ~HOOK_TAP);
+}
+
+static void tap_log(const char *what)
+{
+    log_line("[tap] %s: %s", g_tap_path, what);
+}
+
+/* A fresh file every time: a reader still mapping an old one never
+ * sees it truncated under it.                                    */
+static int tap_open(void)
+{
+    const char *path = secure_getenv("SCROLL_SPEED_TAP");
+    const char *dir = secure_getenv("XDG_RUNTIME_DIR");
+    int n;
+    if (path && *path)
+        n = snprintf(g_tap_path, sizeof(g_tap_path), "%s", path);
+    else if (dir && *dir)
+        n = snprintf(g_tap_path, sizeof(g_tap_path), "%s/%s",
+                     dir, SS_TAP_NAME);
+    else
+        return -1;
+    if (n < 0 || (size_t)n >= sizeof(g_tap_path))
+        return -1;
+
+    unlink(g_tap_path);
+    int fd = open(g_tap_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return -1;
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, sizeof(struct ss_tap)) == 0)
+        p = mmap(NULL, sizeof(struct ss_tap), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        unlink(g_tap_path);
+        return -1;
+    }
+
+    struct ss_tap *t = p;   /* zero-filled by ftruncate */
+    t->version = SS_TAP_VERSION;
+    t->size = sizeof(*t);
+    t->producer = (int32_t)getpid();
+    atomic_thread_fence(memory_order_release);
+    memcpy(t->magic, SS_TAP_MAGIC, sizeof(t->magic));
+
+    g_tap_map = t;
+    atomic_store(&g_tap, t);
+    tap_log("created");
+    return 0;
+}
+
+/* Engine thread, or engine_shutdown with no getter running */
+static void tap_close(void)
+{
+    if (!g_tap_map)
+        return;
+    tap_hook(0);
+    atomic_store(&g_tap, NULL);
+    int epoch = atomic_fetch_xor(&g_tap_epoch, 1);
+    while (atomic_load(&g_tap_inflight[epoch]) > 0)
+        sched_yield();
+    atomic_store(&g_tap_map->closed, 1);
+    munmap(g_tap_map, sizeof(*g_tap_map));
+    unlink(g_tap_path);
+    g_tap_map = NULL;
+}
+
+/* Engine thread, every loop: follow event-tap, and turn the getter
+ * hook on while a reader is attached.  Returns the poll timeout. */
+static int tap_tick(void)
+{
+    int want = active_snapshot()->cfg->event_tap;
+
+    if (!want) {
+        tap_close();
+        g_tap_failed = 0;
+        return RELOAD_INTERVAL * 1000;
+    }
+    if (!g_tap_map && !g_tap_failed && tap_open() != 0) {
+        g_tap_failed = 1;
+        tap_log(strerror(errno));
+    }
+    if (!g_tap_map)
+        return RELOAD_INTERVAL * 1000;
+
+    /* A reader that exits without letting go (killed) is released */
+    int32_t reader = atomic_load(&g_tap_map->reader);
+    if (reader != 0 && (reader < 0 || (kill(reader, 0) != 0 &&
+                                       errno == ESRCH))) {
+        atomic_compare_exchange_strong(&g_tap_map->reader, &reader, 0);
+        reader = 0;
+    }
+    int on = (atomic_load_explicit(&g_hooks, memory_order_relaxed) &
+              HOOK_TAP) != 0;
+    if (on != (reader != 0))
+        tap_hook(reader != 0);
+    return TAP_CHECK_MS;
+}
+
+/* ── Session log (session-log=DIR) ────────────────────────── */
+
+/* The getters copy the raw value of each event, as Mutter reads it
+ * (v120 for wheels, the plain value otherwise), into an in-process
+ * ring, with a device record whenever the device changes.  The
+ * engine thread drains it every SESSION_DRAIN_MS into the current
+ * file (scroll-speed-log.h), flushes, and rotates at
+ * session-log-size KiB, keeping session-log-files files.  A full
+ * ring drops the record and counts it: the getters never wait for
+ * the disk.                                                      */
+#define SESSION_RECORDS  2048   /* power of two */
+#define SESSION_DRAIN_MS 1000
+#define SESSION_DEVICE   3      /* kind after the SS_LOG_* sources */
+#define SESSION_PREFIX   "scroll-"
+
+struct session_record {
+    uint8_t  kind;        /* SS_LOG_FINGER …, SESSION_DEVICE */
+    uint8_t  axis;
+    uint16_t vendor, product;
+    float    width, height;   /* mm; 0 = unknown */
+    uint64_t time_usec;
+    double   value;
+    char     name[48];
+};
+
+static struct session_record g_sl_ring[SESSION_RECORDS];
+static _Atomic uint64_t g_sl_head;      /* getters, under g_input_lock */
+static _Atomic uint64_t g_sl_tail;      /* engine thread */
+static _Atomic uint64_t g_sl_dropped;   /* getters */
+
+/* Getters only, under g_input_lock */
+static const struct libinput_event_pointer *g_sl_event;
+static uint64_t g_sl_event_time;
+static unsigned g_sl_event_axis;
+static struct libinput_device *g_sl_device;
+static const char *g_sl_device_name;
+
+/* Engine thread only */
+static struct ss_log_writer g_sl_writer;   /* .f NULL = no file */
+static struct ss_log_device g_sl_last;     /* re-sent in each new file */
+static int      g_sl_have_device;
+static uint64_t g_sl_written_drops;
+static char     g_sl_dir[SS_MAX_PATH];
+static long     g_sl_max_bytes;            /* session-log-size */
+static int      g_sl_keep;                 /* session-log-files */
+static long     g_sl_next;                 /* CLOCK_MONOTONIC ms */
+static int      g_sl_failed;               /* logged, until one works */
+
+static void session_push(const struct session_record *r)
+{
+    uint64_t head = atomic_load_explicit(&g_sl_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&g_sl_tail, memory_order_acquire) >=
+        SESSION_RECORDS) {
+        lat_add(&g_sl_dropped, 1);
+        return;
+    }
+    g_sl_ring[head % SESSION_RECORDS] = *r;
+    atomic_store_explicit(&g_sl_head, head + 1, memory_order_release);
+}
+
+/* A getter call (g_input_lock held); only the one Mutter uses for
+ * the event's source counts, and only once per event and axis.   */
+static void session_record(struct libinput_event_pointer *event, int v120,
+                           enum libinput_pointer_axis axis)
+{
+    struct libinput_event *base = real_get_base_event(event);
+    struct session_record r;
+    switch (real_get_type(base)) {
+    case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:     r.kind = SS_LOG_FINGER; break;
+    case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:      r.kind = SS_LOG_WHEEL; break;
+    case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: r.kind = SS_LOG_CONTINUOUS; break;
+    default:                                       return;
+    }
+    if (v120 != (r.kind == SS_LOG_WHEEL))
+        return;
+    uint64_t t = real_get_time_usec ? real_get_time_usec(event) : 0;
+    if (event == g_sl_event && t == g_sl_event_time &&
+        (unsigned)axis == g_sl_event_axis)
+        return;
+    g_sl_event = event;
+    g_sl_event_time = t;
+    g_sl_event_axis = axis;
+
+    struct libinput_device *device = real_get_device
+        ? real_get_device(base) : NULL;
+    const char *name = device && real_device_get_name
+        ? real_device_get_name(device) : NULL;
+    if (device && (device != g_sl_device || name != g_sl_device_name)) {
+        struct session_record d = { .kind = SESSION_DEVICE };
+        double w = 0.0, h = 0.0;
+        if (real_device_get_size && real_device_get_size(device, &w, &h) != 0)
+            w = h = 0.0;
+        d.vendor = (uint16_t)(real_device_get_id_vendor
+            ? real_device_get_id_vendor(device) : 0);
+        d.product = (uint16_t)(real_device_get_id_product
+            ? real_device_get_id_product(device) : 0);
+        d.width = (float)w;
+        d.height = (float)h;
+        snprintf(d.name, sizeof(d.name), "%s", name ? name : "");
+        session_push(&d);
+        g_sl_device = device;
+        g_sl_device_name = name;
+    }
+
+    r.axis = axis == LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL;
+    r.time_usec = t;
+    /* In trace units: wheels in degrees */
+    r.value = v120 ? real_get_scroll_value_v120(event, axis) / 8.0
+                   : real_get_scroll_value(event, axis);
+    session_push(&r);
+}
+
+static void session_log_error(const char *what, int err)
+{
+    if (g_sl_failed)
+        return;
+    g_sl_failed = 1;
+    log_line("[session-log] %s: %s", what, strerror(err));
+}
+
+static int session_filter(const struct dirent *d)
+{
+    size_t n = strlen(d->d_name), k = strlen(SS_LOG_SUFFIX);
+    return strncmp(d->d_name, SESSION_PREFIX, strlen(SESSION_PREFIX)) == 0 &&
+           n > k && strcmp(d->d_name + n - k, SS_LOG_SUFFIX) == 0;
+}
+
+/* Remove the oldest files (by name, which is by time) beyond `keep` */
+static void session_prune(const char *dir, int keep)
+{
+    struct dirent **list;
+    int n = scandir(dir, &list, session_filter, alphasort);
+    if (n < 0)
+        return;
+    for (int i = 0; i < n; i++) {
+        if (i < n - keep) {
+            char path[SS_MAX_PATH + 256];
+            snprintf(path, sizeof(path), "%s/%s", dir, list[i]->d_name);
+            unlink(path);
+        }
+        free(list[i]);
+    }
+    free(list);
+}
+
+/* A new file, named after the local time; -NN tells apart files of
+ * the same second and keeps them in order.                        */
+static int session_open(const char *dir)
+{
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        session_log_error(dir, errno);
+        return -1;
+    }
+    time_t now = time(NULL);
+    struct tm tm;
+    char stamp[32];
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    char path[SS_MAX_PATH + 64];
+    int rc = -1;
+    for (int i = 0; i < 100 && rc != 0; i++) {
+        snprintf(path, sizeof(path), "%s/" SESSION_PREFIX "%s-%02d"
+                 SS_LOG_SUFFIX, dir, stamp, i);
+        rc = ss_log_open(&g_sl_writer, path);
+        if (rc != 0 && errno != EEXIST)
+            break;
+    }
+    if (rc != 0) {
+        session_log_error(path, errno);
+        return -1;
+    }
+    if (g_sl_have_device)
+        ss_log_device(&g_sl_writer, &g_sl_last);
+    g_sl_failed = 0;
+    session_prune(dir, g_sl_keep);
+    return 0;
+}
+
+static void session_finish(void)
+{
+    if (g_sl_writer.f && ss_log_close(&g_sl_writer) != 0)
+        session_log_error(g_sl_dir, errno);
+}
+
+/* Move what the getters left in the ring to the file: none, if
+ * there is no directory or it cannot be written.              */
+static void session_drain(const char *dir)
+{
+    uint64_t head = atomic_load_explicit(&g_sl_head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&g_sl_tail, memory_order_relaxed);
+    for (; tail != head; tail++) {
+        const struct session_record *r = &g_sl_ring[tail % SESSION_RECORDS];
+        if (r->kind == SESSION_DEVICE) {
+            g_sl_last.vendor = r->vendor;
+            g_sl_last.product = r->product;
+            g_sl_last.width = r->width;
+            g_sl_last.height = r->height;
+            snprintf(g_sl_last.name, sizeof(g_sl_last.name), "%s", r->name);
+            g_sl_have_device = 1;
+            if (g_sl_writer.f)
+                ss_log_device(&g_sl_writer, &g_sl_last);
+            continue;
+        }
+        if (!dir[0])
+            continue;
+        if (g_sl_writer.f && g_sl_writer.bytes >= g_sl_max_bytes)
+            session_finish();
+        if (!g_sl_writer.f && session_open(dir) != 0)
+            continue;
+        uint64_t dropped = atomic_load_explicit(&g_sl_dropped,
+                                                memory_order_relaxed);
+        if (dropped != g_sl_written_drops) {
+            ss_log_dropped(&g_sl_writer, dropped - g_sl_written_drops);
+            g_sl_written_drops = dropped;
+        }
+        struct ss_log_event e = {
+            .time_usec = r->time_usec, .source = r->kind,
+            .axis = r->axis, .value = r->value,
+        };
+        ss_log_event(&g_sl_writer, &e);
+    }
+    atomic_store_explicit(&g_sl_tail, tail, memory_order_release);
+    if (g_sl_writer.f && ss_log_flush(&g_sl_writer) != 0) {
+        session_log_error(g_sl_dir, errno);
+        ss_log_close(&g_sl_writer);
+    }
+}
+
+/* Engine thread, every loop: drain when due, close the file when
+ * session-log changes.  Returns the poll timeout.              */
+static int session_tick(void)
+{
+    char dir[SS_MAX_PATH];
+    const struct ss_config *c = active_snapshot()->cfg;
+    snprintf(dir, sizeof(dir), "%s", c->session_log);
+    g_sl_max_bytes = c->session_log_size * 1024L;
+    g_sl_keep = c->session_log_files;
+
+    if (strcmp(dir, g_sl_dir) != 0) {
+        if (g_sl_dir[0])
+            session_drain(g_sl_dir);   /* the old one's */
+        session_finish();
+        snprintf(g_sl_dir, sizeof(g_sl_dir), "%s", dir);
+        g_sl_failed = 0;
+        g_sl_next = 0;
+    }
+    if (!dir[0]) {
+        session_drain(dir);   /* stragglers from just before: dropped */
+        return RELOAD_INTERVAL * 1000;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long now_ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    if (now_ms >= g_sl_next) {
+        g_sl_next = now_ms + SESSION_DRAIN_MS;
+        session_drain(dir);
+    }
+    return (int)(g_sl_next - now_ms);
+}
+
+/* engine_shutdown, with no getter running: the rest goes out */
+static void session_close(void)
+{
+    if (g_sl_dir[0])
+        session_drain(g_sl_dir);
+    session_finish();
+}
+
+/* ── Monitor under the pointer (monitor-scroll-factor) ─────── */
+
+/* Mutter's monitor state belongs to gnome-shell's main thread, so it
+ * is read there: a GLib timeout on the default main context checks
+ * every MON_POLL_MS which monitor the pointer is on and at what
+ * scale, and publishes the first matching rule as one word together
+ * with the config generation it was picked under.  The getters use
+ * it only for their own generation (after a reload the factor is 1
+ * until the next check).
+ *
+ * The timeout is there only while scrolling: the getters flag each
+ * scroll, and the engine thread, looking every MON_ARM_MS, adds the
+ * timeout on a flag and removes it once none came for MON_IDLE_MS.
+ * The pick stays meanwhile, so a gesture starts with the monitor
+ * the last one ended on.  EDID keys are resolved to connectors from
+ * sysfs on the engine thread, every RELOAD_INTERVAL (monitors come
+ * and go).                                                         */
+#define MON_POLL_MS     100
+#define MON_ARM_MS      250
+#define MON_IDLE_MS     1000
+#define MON_RELEASE_SEC 2      /* for the main loop to let go */
+#define DRM_SYSFS       "/sys/class/drm"
+
+struct mon_edid {
+    char key[32];              /* "LEN:40a9", as in the rule */
+    char connector[32];        /* "" = not connected */
+};
+
+/* Engine thread → main thread, under g_mon_lock: the active
+ * snapshot's rules and generation (the main thread cannot read the
+ * snapshot itself without the getters' lock), and the EDID keys.  */
+static pthread_mutex_t g_mon_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ss_monitor_rule g_mon_rules[SS_MAX_MONITOR_RULES];
+static int      g_mon_nrules;
+static unsigned g_mon_gen;
+static struct mon_edid g_mon_edid[SS_MAX_MONITOR_RULES];
+static int g_mon_nedid;
+
+/* Main thread → getters: config gen << 32 | rule + 1 (0 = none);
+ * the pointer's monitor and its scale, for stats.               */
+static _Atomic uint64_t g_mon_pick;
+static atomic_int       g_mon_index = -1;
+static atomic_int       g_mon_scale_pct;
+
+/* Getters → engine thread: a scroll since it last looked */
+static atomic_int g_mon_scrolled;
+
+/* Engine thread only */
+static unsigned g_mon_source;  /* GLib source ID, 0 = none */
+static sem_t    g_mon_released;
+static int      g_mon_failed;  /* no timeout, or one never let go */
+static int      g_mon_held;    /* one never let go: keep the engine mapped */
+static long     g_mon_next;    /* next EDID scan, CLOCK_MONOTONIC ms */
+static long     g_mon_idle;    /* remove the timeout, CLOCK_MONOTONIC ms */
+
+static void mon_log(const char *what)
+{
+    log_line("[monitor] %s", what);
+}
+
+static int mon_available(void)
+{
+    return fn_shell_global_get && fn_shell_global_get_display &&
+           fn_meta_display_get_current_monitor &&
+           fn_meta_display_get_monitor_scale &&
+           ((fn_meta_display_get_context && fn_meta_context_get_backend) ||
+            fn_meta_get_backend) &&
+           fn_meta_backend_get_monitor_manager &&
+           fn_meta_monitor_manager_get_monitor_for_connector &&
+           fn_g_timeout_add_full && fn_g_source_remove;
+}
+
+static void *mon_manager(void *display)
+{
+    void *backend;
+    if (fn_meta_display_get_context && fn_meta_context_get_backend) {
+        void *context = fn_meta_display_get_context(display);
+        backend = context ? fn_meta_context_get_backend(context) : NULL;
+    } else {
+        backend = fn_meta_get_backend();
+    }
+    return backend ? fn_meta_backend_get_monitor_manager(backend) : NULL;
+}
+
+/* The connector a rule refers to, "" if its monitor is not there
+ * (g_mon_lock held)                                             */
+static void mon_connector(const struct ss_monitor_rule *r,
+                          char out[static sizeof(r->output)])
+{
+    if (!strchr(r->output, ':')) {
+        memcpy(out, r->output, sizeof(r->output));
+        return;
+    }
+    out[0] = '\0';
+    for (int i = 0; i < g_mon_nedid; i++)
+        if (strcmp(g_mon_edid[i].key, r->output) == 0) {
+            memcpy(out, g_mon_edid[i].connector, sizeof(r->output));
+            return;
+        }
+}
+
+/* Main thread, a GSourceFunc: never blocks, allocates or makes a
+ * system call.  A tick the engine thread holds g_mon_lock is
+ * skipped.  Returns G_SOURCE_CONTINUE.                         */
+static int mon_poll(void *data)
+{
+    (void)data;
+    void *global = fn_shell_global_get();
+    void *display = global ? fn_shell_global_get_display(global) : NULL;
+    void *manager = display ? mon_manager(display) : NULL;
+    if (!manager)
+        return 1;
+
+    struct ss_monitor_rule rules[SS_MAX_MONITOR_RULES];
+    char connector[SS_MAX_MONITOR_RULES][32];
+    if (pthread_mutex_trylock(&g_mon_lock) != 0)
+        return 1;
+    unsigned gen = g_mon_gen;
+    int n = g_mon_nrules;
+    memcpy(rules, g_mon_rules, (size_t)n * sizeof(rules[0]));
+    for (int i = 0; i < n; i++)
+        mon_connector(&rules[i], connector[i]);
+    pthread_mutex_unlock(&g_mon_lock);
+
+    int index = fn_meta_display_get_current_monitor(display);
+    double scale = index >= 0
+        ? fn_meta_display_get_monitor_scale(display, index) : 0.0;
+    unsigned pick = 0;
+    for (int i = 0; i < n && index >= 0; i++) {
+        if (connector[i][0] &&
+            (rules[i].scale == 0.0 || fabs(rules[i].scale - scale) < 0.01) &&
+            fn_meta_monitor_manager_get_monitor_for_connector(
+                manager, connector[i]) == index) {
+            pick = (unsigned)i + 1;
+            break;
+        }
+    }
+    atomic_store_explicit(&g_mon_index, index, memory_order_relaxed);
+    atomic_store_explicit(&g_mon_scale_pct, (int)lround(scale * 100.0),
+                          memory_order_relaxed);
+    atomic_store_explicit(&g_mon_pick, (uint64_t)gen << 32 | pick,
+                          memory_order_relaxed);
+    return 1;
+}
+
+/* "LEN:40a9" from an EDID base block: the PNP manufacturer ID (three
+ * 5-bit letters, big-endian) and the product code (little-endian) */
+static int edid_key(const uint8_t *e, char *key, size_t len)
+{
+    static const uint8_t header[8] = { 0, 0xff, 0xff, 0xff,
+                                       0xff, 0xff, 0xff, 0 };
+    if (memcmp(e, header, sizeof(header)) != 0)
+        return -1;
+    unsigned mfg = (unsigned)e[8] << 8 | e[9];
+    snprintf(key, len, "%c%c%c:%04x", '@' + (mfg >> 10 & 31),
+             '@' + (mfg >> 5 & 31), '@' + (mfg & 31),
+             (unsigned)(e[10] | e[11] << 8));
+    return 0;
+}
+
+/* The connector of the monitor with EDID `key`, in Mutter's naming:
+ * sysfs has "card1-HDMI-A-1" where Mutter says "HDMI-1".          */
+static void edid_connector(const char *key, char *out, size_t len)
+{
+    out[0] = '\0';
+    DIR *d = opendir(DRM_SYSFS);
+    if (!d)
+        return;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        const char *name = strchr(de->d_name, '-');
+        if (strncmp(de->d_name, "card", 4) != 0 || !name)
+            continue;
+        char path[320], found[16];
+        uint8_t edid[128];
+        snprintf(path, sizeof(path), DRM_SYSFS "/%s/edid", de->d_name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        ssize_t n = read(fd, edid, sizeof(edid));
+        close(fd);
+        if (n != (ssize_t)sizeof(edid) ||
+            edid_key(edid, found, sizeof(found)) != 0 ||
+            strcasecmp(found, key) != 0)
+            continue;
+        name++;
+        if (strncmp(name, "HDMI-A-", 7) == 0)
+            snprintf(out, len, "HDMI-%s", name + 7);
+        else
+            snprintf(out, len, "%s", name);
+        break;
+    }
+    closedir(d);
+}
+
+/* The destroy notify is the shim's, not a function of this
+ * library: once mon_unwatch() has seen it, no engine code runs on
+ * the main thread any more and the engine can be unloaded.      */
+static void mon_watch(void)
+{
+    if (g_mon_failed || sem_init(&g_mon_released, 0, 0) != 0)
+        return;
+    g_mon_source = fn_g_timeout_add_full(0 /* G_PRIORITY_DEFAULT */,
+                                         MON_POLL_MS, mon_poll,
+                                         &g_mon_released,
+                                         g_host->post_sem);
+    if (!g_mon_source) {
+        g_mon_failed = 1;
+        sem_destroy(&g_mon_released);
+        mon_log("no main-loop timeout: monitor-scroll-factor disabled");
+    }
+}
 
-/* ── Version / presence marker (for testing) ──────────────── */
-const char *libscroll_speed_version(void) { return "2.1.0"; }
+/* Engine thread, or engine_shutdown once it is joined.  The pick
+ * stays: it is still the pointer's last monitor.             */
+static void mon_unwatch(void)
+{
+    if (!g_mon_source)
+        return;
+    fn_g_source_remove(g_mon_source);
+    g_mon_source = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += MON_RELEASE_SEC;
+    int rc;
+    while ((rc = sem_timedwait(&g_mon_released, &ts)) != 0 && errno == EINTR)
+        ;
+    if (rc == 0) {
+        sem_destroy(&g_mon_released);
+    } else {
+        g_mon_failed = 1;   /* the semaphore may still be posted */
+        g_mon_held = 1;     /* and mon_poll may still be called */
+        mon_log("the main loop did not release its timeout");
+    }
+}
 
-/* ── Configuration defaults ───────────────────────────────── */
+/* Engine thread, every loop: keep the main thread's timeout while
+ * there are rules (inside gnome-shell) and scrolling, its copy of
+ * the rules current, and the EDID keys among them resolved.
+ * Returns the poll timeout.                                      */
+static int mon_tick(void)
+{
+    char keys[SS_MAX_MONITOR_RULES][32];
+    int nkeys = 0;
+    const struct snapshot *snap = active_snapshot();
+    const struct ss_config *c = snap->cfg;
+    int n = c->nmonitor_rules;
+    for (int i = 0; i < n; i++)
+        if (strchr(c->monitor_rules[i].output, ':'))
+            snprintf(keys[nkeys++], sizeof(keys[0]), "%s",
+                     c->monitor_rules[i].output);
 
-static double cfg_base_speed = 0.46;
-static double cfg_scroll_cap = 20.0;
-static double cfg_discrete_factor = 1.0;
-static double cfg_ramp_softness = 1.0;
-static double cfg_low_cut = 0.0;
+    if (!n || !mon_available()) {
+        mon_unwatch();
+        atomic_store(&g_mon_pick, 0);
+        atomic_store(&g_mon_index, -1);
+        return RELOAD_INTERVAL * 1000;
+    }
 
-/* Per-app scroll factor for Chromium-based browsers.
- * Applied compositor-side by detecting focused window PID.
- * Use < 1.0 to reduce Chrome's scroll speed.               */
-static double cfg_chrome_scroll_factor = 1.0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long now_ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    if (atomic_exchange_explicit(&g_mon_scrolled, 0, memory_order_relaxed)) {
+        g_mon_idle = now_ms + MON_IDLE_MS;
+        if (!g_mon_source)
+            mon_watch();
+    } else if (g_mon_source && now_ms >= g_mon_idle) {
+        mon_unwatch();
+    }
+    if (g_mon_gen != snap->gen) {
+        pthread_mutex_lock(&g_mon_lock);
+        memcpy(g_mon_rules, c->monitor_rules,
+               (size_t)n * sizeof(g_mon_rules[0]));
+        g_mon_nrules = n;
+        g_mon_gen = snap->gen;
+        pthread_mutex_unlock(&g_mon_lock);
+    }
 
-/* ── Internal state ───────────────────────────────────────── */
+    int same = nkeys == g_mon_nedid;
+    for (int i = 0; i < nkeys && same; i++)
+        same = strcmp(keys[i], g_mon_edid[i].key) == 0;
+    if (same && now_ms < g_mon_next)
+        return g_mon_next - now_ms < MON_ARM_MS
+            ? (int)(g_mon_next - now_ms) : MON_ARM_MS;
 
-static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+    struct mon_edid edid[SS_MAX_MONITOR_RULES];
+    for (int i = 0; i < nkeys; i++) {
+        memcpy(edid[i].key, keys[i], sizeof(edid[i].key));
+        edid_connector(keys[i], edid[i].connector,
+                       sizeof(edid[i].connector));
+    }
+    pthread_mutex_lock(&g_mon_lock);
+    memcpy(g_mon_edid, edid, (size_t)nkeys * sizeof(edid[0]));
+    g_mon_nedid = nkeys;
+    pthread_mutex_unlock(&g_mon_lock);
+    g_mon_next = now_ms + RELOAD_INTERVAL * 1000;
+    return MON_ARM_MS;
+}
 
-/* Real libinput function pointers resolved via dlsym */
-static double (*real_get_scroll_value)(
-    struct libinput_event_pointer *, enum libinput_pointer_axis);
-static double (*real_get_scroll_value_v120)(
-    struct libinput_event_pointer *, enum libinput_pointer_axis);
-static struct libinput_event *(*real_get_base_event)(
-    struct libinput_event_pointer *);
-static enum libinput_event_type (*real_get_type)(
-    struct libinput_event *);
+/* Control thread, for the active snapshot */
+static void mon_report(const struct snapshot *snap, FILE *out)
+{
+    const struct ss_config *c = snap->cfg;
+    if (!c->nmonitor_rules)
+        return;
+    if (g_mon_failed || !mon_available()) {
+        fprintf(out, "\n# monitors: not watched (%s)\n", g_mon_failed
+                ? "no main-loop timeout" : "no Mutter monitor manager");
+        return;
+    }
+    uint64_t word = atomic_load(&g_mon_pick);
+    int rule = (unsigned)(word >> 32) == snap->gen
+        ? (int)(word & 0xffffffffu) - 1 : -1;
+    fprintf(out, "\n# monitors: %s on monitor %d at scale %.2f, ",
+            g_mon_source ? "pointer" : "idle, pointer last",
+            atomic_load(&g_mon_index), atomic_load(&g_mon_scale_pct) / 100.0);
+    if (rule >= 0)
+        fprintf(out, "rule %d (%s, x%g)\n", rule,
+                c->monitor_rules[rule].output,
+                c->monitor_rules[rule].factor);
+    else
+        fputs("no rule\n", out);
+}
 
-/* Mutter / GNOME Shell API function pointers.
- * Resolved via dlsym(RTLD_DEFAULT) — only available when
- * loaded into gnome-shell (the compositor process).          */
-static void *(*fn_shell_global_get)(void);
-static void *(*fn_shell_global_get_display)(void *);
-static void *(*fn_meta_display_get_focus_window)(void *);
-static int   (*fn_meta_window_get_pid)(void *);
+/* ── Control socket ───────────────────────────────────────── */
 
-/* Focused-window Chrome detection cache */
-static pid_t g_cached_focus_pid = -1;
-static int   g_cached_is_chrome = 0;
+/* One request line per connection, answered and closed:
+ *   get KEY | set KEY VALUE | dump | switch-profile NAME|auto |
+ *   version | reload-engine
+ * Failures reply with a single "error: ..." line.  The socket sits
+ * in the per-user runtime directory and only the owning user (or
+ * root) may talk to it (SO_PEERCRED).                             */
+#define CTL_SOCKET_NAME "scroll-speed.sock"
+#define CTL_TIMEOUT_SEC 1
+#define CTL_ERR_LEN     160
+static char g_ctl_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static int  g_ctl_fd = -1;
 
-/* Hot-reload: re-read config when /etc/scroll-speed.conf changes */
-#define CONF_PATH "/etc/scroll-speed.conf"
-#define RELOAD_INTERVAL 3  /* seconds between stat() checks */
-static time_t g_conf_mtime = 0;
-static time_t g_last_check = 0;
+static void ctl_report(void *ctx, int line, const char *msg)
+{
+    (void)line;
+    snprintf(ctx, CTL_ERR_LEN, "%s", msg);
+}
+
+/* Edit a copy of the latest snapshot and publish it for the getters.
+ * File reloads run on the same thread, so none can slip in between
+ * the copy and the publish.                                        */
+static void ctl_edit(const struct snapshot *cur, const char *cmd,
+                     char *arg, FILE *out)
+{
+    char err[CTL_ERR_LEN] = "";
+    struct ss_config *c = malloc(sizeof(*c));
+    if (!c) {
+        fputs("error: out of memory\n", out);
+        return;
+    }
+    memcpy(c, cur->cfg, sizeof(*c));
+
+    int rc = 0;
+    if (strcmp(cmd, "set") == 0) {
+        char *val = strchr(arg, ' ');
+        if (!val) {
+            snprintf(err, sizeof(err), "usage: set KEY VALUE");
+            rc = -1;
+        } else {
+            *val++ = '\0';
+            rc = ss_config_set(c, arg, val, err, sizeof(err));
+        }
+    } else if (strcmp(arg, "auto") == 0) {
+        c->forced_profile = -1;
+    } else if ((c->forced_profile = ss_config_find_profile(c, arg)) < 0) {
+        snprintf(err, sizeof(err), "unknown profile '%s'", arg);
+        rc = -1;
+    }
 
-/* ── Config file parser ───────────────────────────────────── */
+    if (rc == 0 && ss_config_finish(c, ctl_report, err) != 0)
+        rc = -1;
+    if (rc != 0) {
+        fprintf(out, "error: %s\n", err);
+        free(c);
+        return;
+    }
+    struct snapshot *s = snapshot_new(c, 0, cur->image, 1);
+    if (!s) {
+        fputs("error: out of memory\n", out);
+        return;
+    }
+    publish_config(s);
+    fputs("ok\n", out);
+}
 
-static void trim(char *s)
+static void ctl_command(char *line, FILE *out)
 {
-    char *end = s + strlen(s) - 1;
-    while (end >= s && (*end == ' ' || *end == '\t' || *end == '\n' || *end == '\r'))
-        *end-- = '\0';
-    char *start = s;
-    while (*start == ' ' || *start == '\t')
-        start++;
-    if (start != s)
-        memmove(s, start, strlen(start) + 1);
+    char *arg = strchr(line, ' ');
+    if (arg) {
+        *arg++ = '\0';
+        arg += strspn(arg, " \t");
+    } else {
+        arg = line + strlen(line);
+    }
+
+    /* Only this thread releases pending snapshots, and an installed
+     * one is released here too once retired: `snap` and `active`
+     * stay valid without a lock, and the getters never wait while
+     * the reply is formatted.                                     */
+    const struct snapshot *active = active_snapshot();
+    const struct snapshot *snap = atomic_load(&g_pending);
+    if (!snap)
+        snap = active;
+    const struct ss_config *cur = snap->cfg;
+
+    if (strcmp(line, "get") == 0) {
+        if (ss_config_get(cur, arg, out) < 0)
+            fprintf(out, "error: unknown key '%s'\n", arg);
+    } else if (strcmp(line, "dump") == 0) {
+        const char *prof = cur->forced_profile >= 0
+            ? cur->profiles[cur->forced_profile].name : "auto";
+        fprintf(out, "# effective config (%s%s), profile: %s\n",
+                snap->image ? "compiled image" : "text config",
+                snap->edited ? " + runtime edits" : "",
+                prof);
+        ss_config_dump(cur, out);
+    } else if (strcmp(line, "version") == 0) {
+        fprintf(out, "shim %s, engine " ENGINE_VERSION "\n",
+                g_host->version);
+    } else if (strcmp(line, "stats") == 0 && !*arg) {
+        latency_report(cur, out);
+        wd_report(cur, out);
+        mon_report(active, out);
+    } else if (strcmp(line, "stats") == 0 && strcmp(arg, "reset") == 0) {
+        latency_reset();
+        wd_reset();
+        fputs("ok\n", out);
+    } else if (strcmp(line, "reload-engine") == 0) {
+        g_host->request_swap();
+        fputs("ok\n", out);
+    } else if ((strcmp(line, "set") == 0 ||
+                strcmp(line, "switch-profile") == 0) && *arg) {
+        ctl_edit(snap, line, arg, out);
+    } else {
+        fprintf(out, "error: usage: get KEY | set KEY VALUE | dump | "
+                "switch-profile NAME|auto | stats [reset] | version | "
+                "reload-engine\n");
+    }
 }
 
-static void load_config(void)
+static void ctl_serve(int fd)
 {
-    FILE *f = fopen(CONF_PATH, "r");
-    if (!f)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 ||
+        (cred.uid != geteuid() && cred.uid != 0))
         return;
 
-    struct stat st;
-    if (fstat(fileno(f), &st) == 0)
-        g_conf_mtime = st.st_mtime;
+    struct timeval tv = { CTL_TIMEOUT_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 
-    char line[256];
-    while (fgets(line, sizeof(line), f)) {
-        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
-            continue;
+    char line[512];
+    size_t n = 0;
+    while (n < sizeof(line) - 1) {
+        ssize_t r = recv(fd, line + n, sizeof(line) - 1 - n, 0);
+        if (r <= 0)
+            break;
+        n += (size_t)r;
+        if (memchr(line, '\n', n))
+            break;
+    }
+    line[n] = '\0';
+    line[strcspn(line, "\r\n")] = '\0';
 
-        char *eq = strchr(line, '=');
-        if (!eq)
-            continue;
+    /* Build the reply first: the lock is not held while sending */
+    char *reply = NULL;
+    size_t reply_len = 0;
+    FILE *out = open_memstream(&reply, &reply_len);
+    if (!out)
+        return;
+    ctl_command(line, out);
+    fclose(out);
 
-        *eq = '\0';
-        char *key = line;
-        char *val = eq + 1;
-        trim(key);
-        trim(val);
-
-        double v = atof(val);
-        if (strcmp(key, "base-speed") == 0)
-            cfg_base_speed = v;
-        else if (strcmp(key, "scroll-cap") == 0)
-            cfg_scroll_cap = v;
-        else if (strcmp(key, "discrete-scroll-factor") == 0)
-            cfg_discrete_factor = v;
-        else if (strcmp(key, "ramp-softness") == 0)
-            cfg_ramp_softness = v;
-        else if (strcmp(key, "low-cut") == 0)
-            cfg_low_cut = v;
-        else if (strcmp(key, "chrome-scroll-factor") == 0)
-            cfg_chrome_scroll_factor = v;
-    }
-    fclose(f);
+    for (size_t off = 0; off < reply_len; ) {
+        ssize_t w = send(fd, reply + off, reply_len - off, MSG_NOSIGNAL);
+        if (w <= 0)
+            break;
+        off += (size_t)w;
+    }
+    free(reply);
 }
 
-/* ── Hot-reload ───────────────────────────────────────────── */
+/* Listen on $XDG_RUNTIME_DIR/scroll-speed.sock (SCROLL_SPEED_SOCKET
+ * overrides, for tests).  A live socket owned by another process is
+ * left alone; a stale one is replaced.  Returns the socket or -1.  */
+static int ctl_listen(void)
+{
+    const char *path = secure_getenv("SCROLL_SPEED_SOCKET");
+    const char *dir = secure_getenv("XDG_RUNTIME_DIR");
+    int n;
+    if (path && *path)
+        n = snprintf(g_ctl_path, sizeof(g_ctl_path), "%s", path);
+    else if (dir && *dir)
+        n = snprintf(g_ctl_path, sizeof(g_ctl_path), "%s/%s",
+                     dir, CTL_SOCKET_NAME);
+    else
+        return -1;
+    if (n < 0 || (size_t)n >= sizeof(g_ctl_path))
+        return -1;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    memcpy(addr.sun_path, g_ctl_path, (size_t)n + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int probe = errno == EADDRINUSE
+            ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        int live = probe >= 0 &&
+            connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (probe < 0 || live || unlink(g_ctl_path) != 0 ||
+            bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    chmod(g_ctl_path, 0600);
+    if (listen(fd, 4) != 0) {
+        close(fd);
+        unlink(g_ctl_path);
+        return -1;
+    }
+
+    log_line("[control] listening on %s", g_ctl_path);
+    return fd;
+}
+
+/* ── Engine thread ────────────────────────────────────────── */
 
-static void maybe_reload_config(void)
+/* Everything that may block, allocate or free, off the getters:
+ * config reload checks, releasing retired snapshots, the
+ * latency-budget probe, the metrics file, the event tap, the
+ * session log, the main thread's monitor check and the control
+ * socket (if it could be bound).                                */
+static int       g_thread_wake[2] = { -1, -1 };   /* engine_stop → thread */
+static pthread_t g_thread_tid;
+
+static void *engine_thread(void *arg)
 {
-    time_t now = time(NULL);
-    if (now - g_last_check < RELOAD_INTERVAL)
+    (void)arg;
+    struct pollfd pfd[2] = {
+        { .fd = g_thread_wake[0], .events = POLLIN },
+        { .fd = g_ctl_fd,         .events = POLLIN },   /* -1: ignored */
+    };
+    time_t last_check = time(NULL);
+    wd_calibrate();
+    for (;;) {
+        int timeout = wd_tick();
+        int mx = mx_tick();
+        int tap = tap_tick();
+        int sl = session_tick();
+        int mon = mon_tick();
+        if (mx < timeout)
+            timeout = mx;
+        if (tap < timeout)
+            timeout = tap;
+        if (sl < timeout)
+            timeout = sl;
+        if (mon < timeout)
+            timeout = mon;
+        log_drain();
+        int n = poll(pfd, 2, timeout);
+        if (n < 0 && errno != EINTR)
+            sleep(1);
+        if (n > 0 && pfd[0].revents)
+            return NULL;   /* engine_stop: the engine is being unloaded */
+
+        time_t now = time(NULL);
+        if (now - last_check >= RELOAD_INTERVAL) {
+            last_check = now;
+            check_config();
+        }
+        release_retired();
+
+        if (n <= 0 || !pfd[1].revents)
+            continue;
+        int fd = accept4(g_ctl_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN)
+                sleep(1);   /* e.g. EMFILE: back off, don't spin */
+            continue;
+        }
+        ctl_serve(fd);
+        close(fd);
+    }
+}
+
+/* Called once the engine is the active one, i.e. after the first
+ * getter call: only in processes that actually ask for scroll
+ * values (libinput_get_event/libinput_dispatch alone do not load
+ * the engine, see the shim).                                     */
+static void engine_start(void)
+{
+    if (pipe2(g_thread_wake, O_CLOEXEC) != 0) {
+        g_thread_wake[0] = g_thread_wake[1] = -1;
         return;
-    g_last_check = now;
+    }
+    g_ctl_fd = ctl_listen();
 
-    struct stat st;
-    if (stat(CONF_PATH, &st) == 0 && st.st_mtime != g_conf_mtime) {
-        g_conf_mtime = st.st_mtime;
-        load_config();
+    /* The compositor's signal handling stays on its own threads */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int rc = pthread_create(&g_thread_tid, NULL, engine_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc == 0)
+        return;
+
+    log_config_error(NULL, 0, "no engine thread: hot-reload disabled");
+    log_drain();   /* nothing else will */
+    close(g_thread_wake[0]);
+    close(g_thread_wake[1]);
+    g_thread_wake[0] = g_thread_wake[1] = -1;
+    if (g_ctl_fd >= 0) {
+        close(g_ctl_fd);
+        unlink(g_ctl_path);
+        g_ctl_fd = -1;
+    }
+}
+
+/* Join the engine thread before the engine is unloaded; the next
+ * engine binds the socket path again.                          */
+static void engine_stop(void)
+{
+    if (g_thread_wake[1] < 0) {
+        log_drain();   /* no thread, or never started: nobody wrote it */
+        return;
+    }
+    if (write(g_thread_wake[1], "", 1) == 1)
+        pthread_join(g_thread_tid, NULL);
+    log_drain();   /* what the thread had not written yet */
+    close(g_thread_wake[0]);
+    close(g_thread_wake[1]);
+    g_thread_wake[0] = g_thread_wake[1] = -1;
+    if (g_ctl_fd >= 0) {
+        close(g_ctl_fd);
+        unlink(g_ctl_path);
+        g_ctl_fd = -1;
     }
 }
 
@@ -160,16 +2374,44 @@ static void maybe_reload_config(void)
 
 static void do_init(void)
 {
-    real_get_scroll_value = dlsym(RTLD_NEXT,
+    real_get_scroll_value = g_host->resolve(
         "libinput_event_pointer_get_scroll_value");
-    real_get_scroll_value_v120 = dlsym(RTLD_NEXT,
+    real_get_scroll_value_v120 = g_host->resolve(
         "libinput_event_pointer_get_scroll_value_v120");
-    real_get_base_event = dlsym(RTLD_NEXT,
+    real_get_base_event = g_host->resolve(
         "libinput_event_pointer_get_base_event");
-    real_get_type = dlsym(RTLD_NEXT,
+    real_get_type = g_host->resolve(
         "libinput_event_get_type");
+    real_get_time_usec = g_host->resolve(
+        "libinput_event_pointer_get_time_usec");
+    real_get_pointer_event = g_host->resolve(
+        "libinput_event_get_pointer_event");
+    real_has_axis = g_host->resolve(
+        "libinput_event_pointer_has_axis");
+    real_get_device = g_host->resolve(
+        "libinput_event_get_device");
+    real_device_get_name = g_host->resolve(
+        "libinput_device_get_name");
+    real_device_get_id_vendor = g_host->resolve(
+        "libinput_device_get_id_vendor");
+    real_device_get_id_product = g_host->resolve(
+        "libinput_device_get_id_product");
+    real_device_get_size = g_host->resolve(
+        "libinput_device_get_size");
+
+    const char *conf = secure_getenv("SCROLL_SPEED_CONF");
+    if (conf && *conf) {
+        g_conf_path = conf;
+        snprintf(g_image_path, sizeof(g_image_path), "%s.bin", conf);
+    }
 
-    load_config();
+    /* Built-in snapshot, in case there is no config at all */
+    ss_config_defaults(&g_builtin);
+    ss_config_finish(&g_builtin, NULL, NULL);
+
+    struct snapshot *snap = load_config();
+    if (snap)
+        install_config(snap);
 
     /* Resolve Mutter/GNOME Shell API for per-app scroll factor.
      * Always resolve (not gated on config value) so that
@@ -184,52 +2426,62 @@ static void do_init(void)
         dlsym(RTLD_DEFAULT, "meta_display_get_focus_window");
     fn_meta_window_get_pid =
         dlsym(RTLD_DEFAULT, "meta_window_get_pid");
+    fn_meta_display_get_current_monitor =
+        dlsym(RTLD_DEFAULT, "meta_display_get_current_monitor");
+    fn_meta_display_get_monitor_scale =
+        dlsym(RTLD_DEFAULT, "meta_display_get_monitor_scale");
+    fn_meta_display_get_context =
+        dlsym(RTLD_DEFAULT, "meta_display_get_context");
+    fn_meta_context_get_backend =
+        dlsym(RTLD_DEFAULT, "meta_context_get_backend");
+    fn_meta_get_backend =
+        dlsym(RTLD_DEFAULT, "meta_get_backend");
+    fn_meta_backend_get_monitor_manager =
+        dlsym(RTLD_DEFAULT, "meta_backend_get_monitor_manager");
+    fn_meta_monitor_manager_get_monitor_for_connector =
+        dlsym(RTLD_DEFAULT, "meta_monitor_manager_get_monitor_for_connector");
+    fn_g_timeout_add_full = dlsym(RTLD_DEFAULT, "g_timeout_add_full");
+    fn_g_source_remove = dlsym(RTLD_DEFAULT, "g_source_remove");
 
-    /* Log once at init to verify Mutter API resolution */
-    FILE *dbg = fopen("/tmp/scroll-speed-init.log", "a");
-    if (dbg) {
-        char exe[256] = {0};
-        ssize_t r = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
-        if (r > 0) exe[r] = '\0';
-        fprintf(dbg, "[%s] v2.1.0 chrome-factor=%.2f "
-                "shell_global_get=%p display_get_focus=%p "
-                "window_get_pid=%p\n",
-                exe, cfg_chrome_scroll_factor,
-                (void *)fn_shell_global_get,
-                (void *)fn_meta_display_get_focus_window,
-                (void *)fn_meta_window_get_pid);
-        fclose(dbg);
-    }
-}
-
-static void init(void)
-{
-    pthread_once(&g_init_once, do_init);
+    /* Log once at init to verify Mutter API resolution.  The name
+     * is argv[0]: no /proc lookup on the first getter call.       */
+    log_line("[%s] v" ENGINE_VERSION " config=%s chrome-factor=%.2f "
+             "shell_global_get=%p display_get_focus=%p "
+             "window_get_pid=%p monitors=%s",
+             program_invocation_name,
+             active_snapshot()->image ? "image" : "text",
+             g_cfg->chrome_scroll_factor,
+             (void *)fn_shell_global_get,
+             (void *)fn_meta_display_get_focus_window,
+             (void *)fn_meta_window_get_pid,
+             mon_available() ? "yes" : "no");
 }
 
-/* ── Focused-window Chrome detection ─────────────────────── */
+/* ── Focused-window app detection ─────────────────────────── */
 
-static int is_focused_chrome(void)
+static int focused_app_rule(void)
 {
     if (!fn_shell_global_get || !fn_shell_global_get_display ||
         !fn_meta_display_get_focus_window || !fn_meta_window_get_pid)
-        return 0;
+        return -1;
 
     void *global = fn_shell_global_get();
-    if (!global) return 0;
+    if (!global) return -1;
 
     void *display = fn_shell_global_get_display(global);
-    if (!display) return 0;
+    if (!display) return -1;
 
     void *window = fn_meta_display_get_focus_window(display);
-    if (!window) return 0;
+    if (!window) return -1;
 
     pid_t pid = fn_meta_window_get_pid(window);
-    if (pid <= 0) return 0;
+    if (pid <= 0) return -1;
 
-    if (pid != g_cached_focus_pid) {
+    if (pid != g_cached_focus_pid || g_cached_focus_gen != g_config_gen) {
         g_cached_focus_pid = pid;
-        g_cached_is_chrome = 0;
+        g_cached_focus_gen = g_config_gen;
+        g_cached_rule = -1;
+        lat_add(&g_mx_focus_misses, 1);
 
         char path[64];
         char exe[256];
@@ -237,102 +2489,640 @@ static int is_focused_chrome(void)
         ssize_t n = readlink(path, exe, sizeof(exe) - 1);
         if (n > 0) {
             exe[n] = '\0';
-            if (strstr(exe, "chrome") || strstr(exe, "chromium") ||
-                strstr(exe, "electron"))
-                g_cached_is_chrome = 1;
+            for (int i = 0; i < g_cfg->napp_total; i++) {
+                if (strstr(exe, g_cfg->app_rules[i].pattern)) {
+                    g_cached_rule = i;
+                    break;
+                }
+            }
         }
+        SS_PROBE(focus_change, pid, g_cached_rule,
+                 g_cached_rule >= 0 ? g_cfg->app_rules[g_cached_rule].pattern
+                                    : "");
     }
 
-    return g_cached_is_chrome;
+    return g_cached_rule;
 }
 
-/* ── Non-linear transform (Hill function) ─────────────────── */
+/* ── Gesture tracking ─────────────────────────────────────── */
+
+static void gesture_reset(struct gesture *g)
+{
+    memset(g, 0, sizeof(*g));
+}
 
-static double transform_finger(double delta)
+/* Index of the n-th most recent history entry (0 = newest).  Unsigned
+ * so the modulo of the power-of-two history is a plain mask. */
+static int gesture_index(const struct gesture *g, int n)
 {
-    if (cfg_scroll_cap <= 0.0)
-        return delta * cfg_base_speed;
+    return (unsigned)(g->head + GESTURE_HISTORY - 1 - n) % GESTURE_HISTORY;
+}
 
-    double sign = (delta >= 0.0) ? 1.0 : -1.0;
-    double abs_d = fabs(delta);
-    double normalized = abs_d / cfg_scroll_cap;
+static void gesture_push(struct gesture *g, uint64_t t, double out)
+{
+    g->time[g->head] = t;
+    g->out[g->head] = out;
+    g->head = (unsigned)(g->head + 1) % GESTURE_HISTORY;
+    if (g->count < GESTURE_HISTORY)
+        g->count++;
+}
+
+/* Mean output velocity (units/µs) if `out` were appended at time t,
+ * over the last `window` deltas.  The entry before the window only
+ * marks its start time.  Returns 0 while the history is too short. */
+static double gesture_velocity(const struct gesture *g, uint64_t t,
+                               double out, int window)
+{
+    int n = window - 1;   /* history deltas inside the window */
+    if (n > g->count - 1)
+        n = g->count - 1;
+    if (n < 0)
+        return 0.0;
+
+    uint64_t start = g->time[gesture_index(g, n)];
+    if (t <= start)
+        return 0.0;
+
+    double sum = out;
+    for (int i = 0; i < n; i++)
+        sum += g->out[gesture_index(g, i)];
+    return sum / (double)(t - start);
+}
+
+/* Velocity cap: bound each delta of the gesture at stop-velocity-max
+ * × the mean event interval of the last stop-shaping-events deltas.
+ * A lift at full speed gives no warning (no slowdown precedes it), so
+ * the cap is not limited to the deltas before a stop: it holds for
+ * the whole gesture, and with it the mean velocity clients sample at
+ * the stop.  The interval averaging keeps jitter in event timing out
+ * of the output.                                                    */
+static double cap_velocity(const struct gesture *g, uint64_t t,
+                           double out)
+{
+    int n = g_cfg->stop_shaping_events;
+    if (n > g->count)
+        n = g->count;
+    if (n < 1)
+        return out;   /* first delta of a gesture: no interval yet */
+
+    uint64_t start = g->time[gesture_index(g, n - 1)];
+    if (t <= start)
+        return out;
+
+    double limit = g_cfg->stop_velocity_max * (double)(t - start) / 1000.0 / n;
+    if (fabs(out) > limit)
+        out = copysign(limit, out);
+    return out;
+}
+
+/* Look-ahead of PREDICT_WINDOW-event velocity × prediction-horizon,
+ * bounded by prediction-max, while the gesture is at its fastest so
+ * far.  Below that peak the target is 0: the lead is settled over
+ * the slowdown (or the steady part) before the stop, instead of
+ * being left in the content at lift.  Runs after gesture_push().  */
+static double predict(struct gesture *g, uint64_t t, double out)
+{
+    double v = gesture_velocity(g, t, 0.0, PREDICT_WINDOW + 1);
+    double target = 0.0;
+    if (fabs(v) >= g->peak) {
+        g->peak = fabs(v);
+        target = v * g_cfg->predict_horizon * 1000.0;
+        if (target > g_cfg->predict_max)
+            target = g_cfg->predict_max;
+        else if (target < -g_cfg->predict_max)
+            target = -g_cfg->predict_max;
+    }
+
+    /* Claw back at most prediction-damping of this delta, so the
+     * emitted value never reverses direction or collapses to 0.  */
+    double adj = target - g->lead;
+    double limit = g_cfg->predict_damping * fabs(out);
+    if (adj * out < 0.0 && fabs(adj) > limit)
+        adj = copysign(limit, adj);
+
+    g->lead += adj;
+    return out + adj;
+}
 
-    if (cfg_ramp_softness != 1.0 && normalized > 0.0)
-        normalized = pow(normalized, cfg_ramp_softness);
+static double gesture_output(struct libinput_event_pointer *event,
+                            enum libinput_pointer_axis axis, double out)
+{
+    if ((g_cfg->predict_horizon <= 0.0 && g_cfg->stop_velocity_max <= 0.0) ||
+        !real_get_time_usec)
+        return out;
+
+    struct gesture *g = &g_gesture[axis & 1];
 
-    double out = cfg_base_speed * cfg_scroll_cap * (normalized / (1.0 + normalized));
+    /* libinput reports a scroll stop as 0.0 — pass it through untouched
+     * (clients key kinetic scrolling off it).  predict() has settled
+     * the lead by now unless the fingers left at top speed; that rest
+     * (at most prediction-max) is dropped.                           */
+    if (out == 0.0) {
+        gesture_reset(g);
+        return out;
+    }
 
-    if (cfg_low_cut > 0.0) {
-        double d2 = abs_d * abs_d;
-        double d4 = d2 * d2;
-        double t2 = cfg_low_cut * cfg_low_cut;
-        double t4 = t2 * t2;
-        out *= d4 / (t4 + d4);
+    uint64_t t = real_get_time_usec(event);
+    if (g->active) {
+        uint64_t last = g->time[gesture_index(g, 0)];
+        if (t == last && out == g->last_raw)
+            return g->last_emit;
+        if (t < last || t - last > GESTURE_GAP_USEC ||
+            (out > 0.0) != (g->out[gesture_index(g, 0)] > 0.0))
+            gesture_reset(g);
     }
+    g->active = 1;
+    g->last_raw = out;
+
+    if (g_cfg->stop_velocity_max > 0.0)
+        out = cap_velocity(g, t, out);
+    gesture_push(g, t, out);
 
-    return sign * out;
+    if (g_cfg->predict_horizon > 0.0)
+        out = predict(g, t, out);
+
+    g->last_emit = out;
+    return out;
 }
 
-/* ── Per-app scroll factor ────────────────────────────────── */
+/* ── Per-device profiles ──────────────────────────────────── */
 
-static double app_scroll_factor(void)
+static int profile_matches(const struct ss_profile *p, const char *name,
+                           unsigned int vendor, unsigned int product)
 {
-    if (cfg_chrome_scroll_factor != 1.0 && is_focused_chrome())
-        return cfg_chrome_scroll_factor;
-    return 1.0;
+    unsigned int v, pr;
+    int n = 0;
+    if (sscanf(p->match, "%4x:%4x%n", &v, &pr, &n) == 2 &&
+        p->match[n] == '\0')
+        return v == vendor && pr == product;
+    return p->match[0] && name && strstr(name, p->match);
 }
 
-/* ── Intercepted libinput API (runs inside Mutter) ────────── */
+static void resolve_device(struct device_entry *e,
+                           struct libinput_device *device, const char *name)
+{
+    unsigned int vendor = real_device_get_id_vendor
+        ? real_device_get_id_vendor(device) : 0;
+    unsigned int product = real_device_get_id_product
+        ? real_device_get_id_product(device) : 0;
+
+    e->device = device;
+    e->name = name;
+    e->gen = g_config_gen;
+    e->profile = g_cfg->forced_profile >= 0 ? g_cfg->forced_profile : 0;
+    for (int i = 1; i < g_cfg->nprofiles && g_cfg->forced_profile < 0; i++) {
+        if (profile_matches(&g_cfg->profiles[i], name, vendor, product)) {
+            e->profile = i;
+            break;
+        }
+    }
+
+    /* Physical units need the device resolution; libinput_device_get_size
+     * fails exactly when libinput could not normalize the deltas.     */
+    double w = 0.0, h = 0.0;
+    int sized = real_device_get_size &&
+                real_device_get_size(device, &w, &h) == 0;
+    e->scale = 1.0;
+    if (g_cfg->profiles[e->profile].physical_units && sized)
+        e->scale = MM_PER_UNIT;
+
+    const char *units = "";
+    if (e->scale != 1.0)
+        units = " (mm)";
+    else if (g_cfg->profiles[e->profile].physical_units)
+        units = " (no size, raw units)";
 
-double libinput_event_pointer_get_scroll_value(
-    struct libinput_event_pointer *event,
-    enum libinput_pointer_axis axis)
+    log_line("[device] %s (%04x:%04x, %.0fx%.0f mm) -> profile %s%s",
+             name ? name : "?", vendor, product, w, h,
+             g_cfg->profiles[e->profile].name, units);
+}
+
+/* Profile for the event's device and the scale from its raw deltas
+ * to the profile's curve input. */
+static const struct ss_profile *event_profile(struct libinput_event *base,
+                                           double *scale)
+{
+    *scale = 1.0;
+    if (!g_profiles_active || !real_get_device || !real_device_get_name)
+        return &g_cfg->profiles[0];
+
+    struct libinput_device *device = real_get_device(base);
+    if (!device)
+        return &g_cfg->profiles[0];
+    const char *name = real_device_get_name(device);
+
+    struct device_entry *e = NULL;
+    for (int i = 0; i < DEVICE_CACHE; i++) {
+        if (g_devices[i].device == device) {
+            e = &g_devices[i];
+            break;
+        }
+    }
+    if (!e || e->gen != g_config_gen || e->name != name) {
+        if (!e) {
+            e = &g_devices[g_device_next];
+            g_device_next = (g_device_next + 1) % DEVICE_CACHE;
+        }
+        resolve_device(e, device, name);
+    }
+
+    *scale = e->scale;
+    return &g_cfg->profiles[e->profile];
+}
+
+/* ── TrackPoint velocity model ─────────────────────────────── */
+
+static double transform_trackpoint(struct libinput_event_pointer *event,
+                                   enum libinput_pointer_axis axis,
+                                   const struct ss_curve *c, double raw)
 {
-    init();
-    maybe_reload_config();
-    if (!real_get_scroll_value || !real_get_base_event || !real_get_type)
+    if (!g_cfg->trackpoint_velocity || !real_get_time_usec)
+        return transform(c, raw);
+
+    struct trackpoint_state *tp = &g_trackpoint[axis & 1];
+    if (raw == 0.0) {
+        tp->time = 0;
         return 0.0;
+    }
+
+    /* The first event after a pause has no meaningful interval; treat
+     * it as arriving on the reference rate.  Repeated getter calls
+     * for the same event reuse its interval.                        */
+    double ref = g_cfg->trackpoint_ref_interval * 1000.0;
+    uint64_t t = real_get_time_usec(event);
+    if (t != tp->time) {
+        double dt = (tp->time && t > tp->time) ? (double)(t - tp->time) : ref;
+        if (dt > 3.0 * ref)
+            dt = ref;
+        else if (dt < 0.25 * ref)
+            dt = 0.25 * ref;
+        tp->time = t;
+        tp->dt = dt;
+    }
+
+    return transform(c, raw * ref / tp->dt) * tp->dt / ref;
+}
+
+/* ── Mouse wheel acceleration ─────────────────────────────── */
+
+/* `detents` is the event's movement in wheel clicks (v120 / 120, or
+ * degrees / 15 on the legacy path).  Both getters may be called for
+ * the same event; the second call reuses the first call's factor.  */
+static double wheel_factor(struct libinput_event_pointer *event,
+                           enum libinput_pointer_axis axis, double detents)
+{
+    if (g_cfg->wheel_accel_ramp <= 0.0 || detents == 0.0 || !real_get_time_usec)
+        return g_cfg->discrete_factor;
+
+    struct wheel_state *w = &g_wheel[axis & 1];
+    uint64_t t = real_get_time_usec(event);
+    if (t == w->time)
+        return w->factor;
+
+    int sign = detents > 0.0 ? 1 : -1;
+    double accel = 1.0;
+    if (w->time && sign == w->sign && t > w->time &&
+        t - w->time < WHEEL_RESET_USEC) {
+        double per_detent = (double)(t - w->time) / fabs(detents);
+        w->interval = w->interval > 0.0
+            ? 0.5 * (w->interval + per_detent) : per_detent;
+        accel = 1.0 + g_cfg->wheel_accel_ramp *
+                (g_cfg->wheel_accel_threshold * 1000.0 / w->interval - 1.0);
+        if (accel < 1.0)
+            accel = 1.0;
+        else if (accel > g_cfg->wheel_accel_max)
+            accel = g_cfg->wheel_accel_max;
+    } else {
+        w->interval = 0.0;
+    }
+
+    w->time = t;
+    w->sign = sign;
+    w->factor = g_cfg->discrete_factor * accel;
+    return w->factor;
+}
+
+/* ── Per-app and per-monitor scroll factor ────────────────── */
+
+/* The rule the main thread picked, if it is for this config; and
+ * the flag that keeps it picking (a load first, so a gesture does
+ * not keep taking the line from the engine thread).            */
+__attribute__((noinline))
+static double monitor_factor(void)
+{
+    if (!atomic_load_explicit(&g_mon_scrolled, memory_order_relaxed))
+        atomic_store_explicit(&g_mon_scrolled, 1, memory_order_relaxed);
+    uint64_t pick = atomic_load_explicit(&g_mon_pick, memory_order_relaxed);
+    unsigned rule = (unsigned)pick;
+    if ((unsigned)(pick >> 32) != g_config_gen || !rule)
+        return 1.0;
+    return g_cfg->monitor_rules[rule - 1].factor;
+}
+
+/* Inlined into every caller, the monitor part out of line and tested
+ * first, while g_cfg is still in a register: with no monitor rules it
+ * adds a compare and a branch to the app factor.                   */
+__attribute__((always_inline))
+static inline double scroll_factor(void)
+{
+    double factor = 1.0;
+    if (g_cfg->nmonitor_rules)
+        factor = monitor_factor();
+    if (g_cfg->napp_total) {
+        int rule = focused_app_rule();
+        if (rule >= 0)
+            factor *= g_cfg->app_rules[rule].factor;
+    }
+    return factor;
+}
+
+/* ── Intercepted libinput API (runs inside Mutter) ────────── */
 
+/* The transform proper, with the app's and monitor's factor.  The
+ * stateful stages see repeated calls for one event (the other
+ * getter, or a lookup miss after dequeue-transform) as one.  Both
+ * this and event_value_v120 are inlined into the getters and
+ * side_fill alike: an out-of-line call would cost the getters more
+ * than their hook test.                                          */
+__attribute__((always_inline))
+static inline double event_value(struct libinput_event_pointer *event,
+                                 enum libinput_pointer_axis axis,
+                                 double factor)
+{
     double raw = real_get_scroll_value(event, axis);
 
     struct libinput_event *base = real_get_base_event(event);
     enum libinput_event_type type = real_get_type(base);
 
-    double factor = app_scroll_factor();
+    double scale;
+    const struct ss_profile *prof = event_profile(base, &scale);
 
+    double out;
     switch (type) {
     case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
-        return transform_finger(raw) * factor;
+        out = gesture_output(event, axis,
+                             transform(&prof->finger, raw * scale) * factor);
+        break;
     case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
-        return raw * cfg_discrete_factor;
+        out = raw * wheel_factor(event, axis, raw / 15.0);
+        break;
     case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS:
-        return transform_finger(raw) * factor;
+        out = gesture_output(event, axis,
+            transform_trackpoint(event, axis, &prof->trackpoint, raw * scale)
+            * factor);
+        break;
     default:
-        return raw;
+        out = raw;
+        break;
     }
+    SS_PROBE(transform, type, axis, 0, ss_probe_bits(raw), ss_probe_bits(out));
+    return out;
 }
 
-double libinput_event_pointer_get_scroll_value_v120(
-    struct libinput_event_pointer *event,
-    enum libinput_pointer_axis axis)
+__attribute__((always_inline))
+static inline double event_value_v120(struct libinput_event_pointer *event,
+                                      enum libinput_pointer_axis axis)
 {
-    init();
-    maybe_reload_config();
-    if (!real_get_scroll_value_v120 || !real_get_base_event || !real_get_type)
-        return 0.0;
-
     double raw = real_get_scroll_value_v120(event, axis);
 
     struct libinput_event *base = real_get_base_event(event);
     enum libinput_event_type type = real_get_type(base);
 
-    if (type == LIBINPUT_EVENT_POINTER_SCROLL_WHEEL)
-        return raw * cfg_discrete_factor;
+    double out = raw;
+    if (type == LIBINPUT_EVENT_POINTER_SCROLL_WHEEL) {
+        out = raw * wheel_factor(event, axis, raw / 120.0);
+    } else if (raw != 0.0) {
+        double factor = scroll_factor();
+        double scale;
+        const struct ss_profile *prof = event_profile(base, &scale);
+        if (type == LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS)
+            out = transform_trackpoint(event, axis, &prof->trackpoint,
+                                       raw * scale) * factor;
+        else
+            out = transform(&prof->finger, raw * scale) * factor;
+    }
+    SS_PROBE(transform, type, axis, 1, ss_probe_bits(raw), ss_probe_bits(out));
+    return out;
+}
+
+/* ── Dequeue-time transform (dequeue-transform=1) ─────────── */
+
+/* libinput's event structs start with the base event, so an event
+ * and its pointer event share an address (get_pointer_event is a
+ * cast); slots are keyed by that address.                        */
+static struct side_entry *side_slot(const void *event)
+{
+    return &g_side[((uintptr_t)event >> 4) % SIDE_TABLE];
+}
+
+static int side_lookup(const struct libinput_event_pointer *event,
+                       int v120, enum libinput_pointer_axis axis, double *v)
+{
+    const struct side_entry *s = side_slot(event);
+    unsigned bit = 1u << (v120 << 1 | (axis & 1));
+    if (s->event != event || !(s->have & bit))
+        return 0;
+    *v = s->value[v120][axis & 1];
+    return 1;
+}
+
+/* Config and scroll factor once per batch, then every present axis
+ * through the getter Mutter will use (both for wheels).          */
+static void side_fill(struct libinput_event *base)
+{
+    struct side_entry *s = side_slot(base);
+    s->event = NULL;
+
+    enum libinput_event_type type = real_get_type(base);
+    if (type != LIBINPUT_EVENT_POINTER_SCROLL_FINGER &&
+        type != LIBINPUT_EVENT_POINTER_SCROLL_WHEEL &&
+        type != LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS)
+        return;
+
+    /* A lookup miss inside the batch may have installed a newer
+     * snapshot: the factor then comes from that one too.        */
+    if (atomic_exchange_explicit(&g_batch_new, 0, memory_order_relaxed)) {
+        install_pending();
+        if (!(atomic_load_explicit(&g_hooks, memory_order_relaxed) &
+              HOOK_DEQUEUE))
+            return;
+        g_batch_factor = scroll_factor();
+        g_batch_gen = g_config_gen;
+    } else if (g_batch_gen != g_config_gen) {
+        g_batch_factor = scroll_factor();
+        g_batch_gen = g_config_gen;
+    }
+
+    struct libinput_event_pointer *event = real_get_pointer_event(base);
+    if (!event)
+        return;
+    if (atomic_load_explicit(&g_hooks, memory_order_relaxed) & HOOK_LATENCY)
+        latency_sample(event);
+
+    unsigned have = 0;
+    for (int axis = 0; axis < 2; axis++) {
+        if (!real_has_axis(event, axis))
+            continue;
+        s->value[0][axis] = event_value(event, axis, g_batch_factor);
+        have |= 1u << axis;
+        if (type == LIBINPUT_EVENT_POINTER_SCROLL_WHEEL) {
+            s->value[1][axis] = event_value_v120(event, axis);
+            have |= 1u << (2 | axis);
+        }
+    }
+    s->have = have;
+    s->event = event;
+}
+
+static void engine_dequeued(struct libinput_event *event)
+{
+    unsigned hooks = atomic_load_explicit(&g_hooks, memory_order_relaxed);
+    if (!(hooks & HOOK_DEQUEUE))
+        return;
+    uint64_t t0 = hooks & HOOK_BUDGET ? wd_cycles() : 0;
+    if (!input_trylock()) {
+        atomic_store_explicit(&g_side_stale, 1, memory_order_relaxed);
+        return;
+    }
+    if (!(hooks & HOOK_BUDGET) || !atomic_load(&g_passthrough)) {
+        side_fill(event);
+        if (hooks & HOOK_BUDGET)
+            wd_account(t0);
+    } else {
+        side_slot(event)->event = NULL;   /* no stale hit after recovery */
+    }
+    input_unlock();
+}
+
+static void engine_batch(void)
+{
+    atomic_store_explicit(&g_batch_new, 1, memory_order_relaxed);
+}
 
-    if (raw != 0.0) {
-        double factor = app_scroll_factor();
-        return transform_finger(raw) * factor;
+/* ── Getters ──────────────────────────────────────────────── */
+
+/* With any optional stage on (g_hooks), out of line */
+__attribute__((noinline))
+static double hooked_value(struct libinput_event_pointer *event, int v120,
+                           enum libinput_pointer_axis axis)
+{
+    unsigned hooks = atomic_load_explicit(&g_hooks, memory_order_relaxed);
+    uint64_t t0 = hooks & (HOOK_BUDGET | HOOK_METRICS) ? wd_cycles() : 0;
+    if (!input_trylock())
+        return v120 ? real_get_scroll_value_v120(event, axis)
+                    : real_get_scroll_value(event, axis);
+    double v;
+    int passthrough = (hooks & HOOK_BUDGET) && atomic_load(&g_passthrough);
+    if (passthrough) {
+        install_pending();   /* so that latency-budget=0 can end it */
+        v = v120 ? real_get_scroll_value_v120(event, axis)
+                 : real_get_scroll_value(event, axis);
+        lat_add(&g_wd_raw, 1);
+    } else {
+        if ((hooks & HOOK_DEQUEUE) &&
+            atomic_load_explicit(&g_side_stale, memory_order_relaxed) &&
+            atomic_exchange_explicit(&g_side_stale, 0, memory_order_relaxed))
+            memset(g_side, 0, sizeof(g_side));
+        if (!(hooks & HOOK_DEQUEUE) || !side_lookup(event, v120, axis, &v)) {
+            install_pending();
+            if (hooks & HOOK_LATENCY)
+                latency_sample(event);
+            v = v120 ? event_value_v120(event, axis)
+                     : event_value(event, axis, scroll_factor());
+        }
+        if (hooks & HOOK_BUDGET)
+            wd_account(t0);
     }
+    if (hooks & HOOK_METRICS)
+        mx_account(v120, t0);
+    if (hooks & HOOK_TAP)
+        tap_record(event, v120, axis, v, passthrough);
+    if (hooks & HOOK_SESSION)
+        session_record(event, v120, axis);
+    input_unlock();
+    return v;
+}
+
+static double engine_scroll_value(struct libinput_event_pointer *event,
+                                  enum libinput_pointer_axis axis)
+{
+    if (atomic_load_explicit(&g_hooks, memory_order_relaxed))
+        return hooked_value(event, 0, axis);
+    if (!input_trylock())
+        return real_get_scroll_value(event, axis);
+    install_pending();
+    double v = event_value(event, axis, scroll_factor());
+    input_unlock();
+    return v;
+}
+
+static double engine_scroll_value_v120(struct libinput_event_pointer *event,
+                                       enum libinput_pointer_axis axis)
+{
+    if (atomic_load_explicit(&g_hooks, memory_order_relaxed))
+        return hooked_value(event, 1, axis);
+    if (!input_trylock())
+        return real_get_scroll_value_v120(event, axis);
+    install_pending();
+    double v = event_value_v120(event, axis);
+    input_unlock();
+    return v;
+}
+
+/* ── Engine interface (see scroll-speed-engine.h) ─────────── */
+
+static int engine_init(const struct ss_host *host)
+{
+    g_host = host;
+    do_init();
+    /* The getters rely on these; without them the shim passes through */
+    return real_get_scroll_value && real_get_scroll_value_v120 &&
+           real_get_base_event && real_get_type ? 0 : -1;
+}
 
-    return raw;
+/* Everything this engine owns goes before dlclose: the engine
+ * thread, the main thread's monitor check, the event tap, the
+ * session log (written out), the snapshot (mapped or heap), a
+ * pending and any retired ones.  -1 if the main loop never let go
+ * of a monitor timeout: mon_poll may still run, so the shim keeps
+ * this engine mapped.                                            */
+static int engine_shutdown(void)
+{
+    engine_stop();
+    mon_unwatch();
+    tap_close();
+    session_close();
+    snapshot_release(atomic_exchange(&g_pending, NULL));
+    release_retired();
+    snapshot_release(atomic_exchange(&g_cur, &g_builtin_snap));
+    g_cfg = &g_builtin;
+    log_drain();   /* mon_unwatch's, the thread is gone */
+    return g_mon_held ? -1 : 0;
+}
+
+/* Process exit: what the session log still holds goes out (the
+ * engine thread first, so that the file is this thread's alone).
+ * After engine_shutdown, or without session-log, nothing to do. */
+__attribute__((destructor))
+static void engine_exit(void)
+{
+    engine_stop();
+    session_close();
+}
+
+static const struct ss_engine g_engine_ops = {
+    .abi               = SS_ENGINE_ABI,
+    .version           = ENGINE_VERSION,
+    .init              = engine_init,
+    .start             = engine_start,
+    .shutdown          = engine_shutdown,
+    .scroll_value      = engine_scroll_value,
+    .scroll_value_v120 = engine_scroll_value_v120,
+    .dequeued          = engine_dequeued,
+    .batch             = engine_batch,
+};
+
+SS_EXPORT const struct ss_engine *scroll_speed_engine(void)
+{
+    return &g_engine_ops;
 }
@@ -9,6 +9,10 @@
 #
 # 既存の libinput-config (線形 scroll-factor) を置き換えます。
 # 設定: /etc/scroll-speed.conf
+#
+# 使い方:
+#   bash setup.sh               /etc/ld.so.preload に登録（全プロセス）
+#   bash setup.sh --compositor  systemd ドロップインで gnome-shell だけに読み込む
 
 set -euo pipefail
 
@@ -16,8 +20,16 @@ SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
 LIB_DIR="/usr/local/lib/x86_64-linux-gnu"
 PRELOAD="/etc/ld.so.preload"
 TARGET="libscroll-speed.so"
+ENGINE="libscroll-speed-engine.so"
+CTL="scroll-speed-ctl"
+TAP="scroll-speed-tap"
+LOGDUMP="scroll-speed-logdump"
+BIN_DIR="/usr/local/bin"
 CONF_DEST="/etc/scroll-speed.conf"
 OLD_CONF="/etc/libinput.conf"
+DROPIN_DIR="/etc/systemd/user/org.gnome.Shell@wayland.service.d"
+DROPIN="$DROPIN_DIR/libscroll-speed.conf"
+MODE="preload"
 
 info()  { echo -e "\033[1;34m[INFO]\033[0m  $*"; }
 ok()    { echo -e "\033[1;32m[OK]\033[0m    $*"; }
@@ -56,18 +68,50 @@ install_lib() {
     sudo mv "$LIB_DIR/$TARGET.tmp" "$LIB_DIR/$TARGET"
     ok "ライブラリ → $LIB_DIR/$TARGET (atomic replace)"
 
+    # エンジン: バージョン付きファイル + シンボリックリンクの付け替え
+    # (実行中のシムが数秒以内に新しいエンジンへ差し替える)
+    local stamp
+    stamp="$(date +%Y%m%d%H%M%S)"
+    sudo install -m 644 "$SCRIPT_DIR/$ENGINE" "$LIB_DIR/$ENGINE.$stamp"
+    sudo ln -sfn "$ENGINE.$stamp" "$LIB_DIR/$ENGINE.tmp"
+    sudo mv -T "$LIB_DIR/$ENGINE.tmp" "$LIB_DIR/$ENGINE"
+    for f in "$LIB_DIR/$ENGINE".*; do
+        [[ "$f" == "$LIB_DIR/$ENGINE.$stamp" ]] || sudo rm -f "$f"
+    done
+    ok "エンジン → $LIB_DIR/$ENGINE.$stamp"
+
+    sudo install -m 755 "$SCRIPT_DIR/$CTL" "$BIN_DIR/$CTL"
+    ok "管理コマンド → $BIN_DIR/$CTL"
+    sudo install -m 755 "$SCRIPT_DIR/$TAP" "$BIN_DIR/$TAP"
+    ok "イベントタップ → $BIN_DIR/$TAP"
+    sudo install -m 755 "$SCRIPT_DIR/$LOGDUMP" "$BIN_DIR/$LOGDUMP"
+    ok "セッションログ変換 → $BIN_DIR/$LOGDUMP"
+
     # ld.so.preload: 古い libinput-config を除去
     if grep -q 'libinput-config' "$PRELOAD" 2>/dev/null; then
         warn "libinput-config を ld.so.preload から除去"
         sudo sed -i '/libinput-config/d' "$PRELOAD"
     fi
 
-    # ld.so.preload: libscroll-speed を追加
-    if ! grep -q 'libscroll-speed' "$PRELOAD" 2>/dev/null; then
-        echo "$LIB_DIR/$TARGET" | sudo tee -a "$PRELOAD" > /dev/null
-        ok "ld.so.preload に追加"
+    if [[ $MODE == compositor ]]; then
+        # gnome-shell のユーザーサービスにだけ LD_PRELOAD を設定
+        sudo install -d "$DROPIN_DIR"
+        sudo install -m 644 "$SCRIPT_DIR/gnome-shell-preload.conf" "$DROPIN"
+        ok "systemd ドロップイン → $DROPIN"
+        if grep -q 'libscroll-speed' "$PRELOAD" 2>/dev/null; then
+            sudo sed -i '/libscroll-speed/d' "$PRELOAD"
+            ok "ld.so.preload から除去（gnome-shell 限定に切り替え）"
+        fi
+        systemctl --user daemon-reload 2>/dev/null || true
     else
-        ok "ld.so.preload に既に登録済み"
+        sudo rm -f "$DROPIN"
+        # ld.so.preload: libscroll-speed を追加
+        if ! grep -q 'libscroll-speed' "$PRELOAD" 2>/dev/null; then
+            echo "$LIB_DIR/$TARGET" | sudo tee -a "$PRELOAD" > /dev/null
+            ok "ld.so.preload に追加"
+        else
+            ok "ld.so.preload に既に登録済み"
+        fi
     fi
 
     # 設定ファイル
@@ -78,6 +122,10 @@ install_lib() {
         ok "$CONF_DEST は既存のため保持"
     fi
 
+    # コンパイル済みイメージ（mmap で読み込まれ、パース不要）
+    sudo "$BIN_DIR/$CTL" compile "$CONF_DEST" "$CONF_DEST.bin"
+    ok "コンパイル済みイメージ → $CONF_DEST.bin"
+
     # 古い libinput.conf を無効化 (バックアップ)
     if [[ -f "$OLD_CONF" ]]; then
         warn "旧 $OLD_CONF をバックアップ (libscroll-speed が置き換えます)"
@@ -87,6 +135,12 @@ install_lib() {
 
 # ── メイン ────────────────────────────────────────
 main() {
+    case "${1:-}" in
+        "")           ;;
+        --compositor) MODE=compositor ;;
+        *)            err "不明なオプション: $1"; exit 2 ;;
+    esac
+
     echo ""
     echo -e "\033[1;36m━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\033[0m"
     echo -e "\033[1;36m  libscroll-speed — macOS ライクスクロール\033[0m"
@@ -105,10 +159,15 @@ main() {
 
     echo ""
     ok "インストール完了"
-    warn "反映にはログアウト→再ログインが必要です"
+    warn "初回はログアウト→再ログインが必要です（以降のエンジン更新は自動で反映）"
+    if [[ $MODE == compositor ]]; then
+        info "gnome-shell 限定モード。再ログイン後に確認:"
+        echo "  bash $SCRIPT_DIR/status.sh"
+    fi
     echo ""
     info "設定の調整:"
     echo "  sudo nano $CONF_DEST"
+    echo "  sudo $CTL compile   # 任意: 検証 + イメージ再生成"
     echo ""
     info "アンインストール:"
     echo "  cd $SCRIPT_DIR && make uninstall"
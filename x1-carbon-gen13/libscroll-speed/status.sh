@@ -0,0 +1,104 @@
+#!/usr/bin/env bash
+# status.sh — libscroll-speed の読み込み状況を確認
+#
+# どちらの方式（/etc/ld.so.preload / gnome-shell 限定の systemd ドロップイン）で
+# インストールされているかを表示し、実行中の gnome-shell にシムとエンジンが
+# 読み込まれているか、限定モードなら他のプロセスに漏れていないかを確認します。
+# ログイン中のユーザーで実行してください（sudo 不要）。
+#
+# 終了コード: 0 = 有効, 1 = 無効または問題あり
+
+set -uo pipefail
+
+LIB_DIR="/usr/local/lib/x86_64-linux-gnu"
+PRELOAD="/etc/ld.so.preload"
+UNIT="org.gnome.Shell@wayland.service"
+DROPIN="/etc/systemd/user/$UNIT.d/libscroll-speed.conf"
+CTL="scroll-speed-ctl"
+
+info()  { echo -e "\033[1;34m[INFO]\033[0m  $*"; }
+ok()    { echo -e "\033[1;32m[OK]\033[0m    $*"; }
+warn()  { echo -e "\033[1;33m[WARN]\033[0m  $*"; }
+err()   { echo -e "\033[1;31m[ERROR]\033[0m $*" >&2; }
+
+status=0
+
+maps_has() {   # PID PATTERN
+    grep -q "$2" "/proc/$1/maps" 2>/dev/null
+}
+
+# ── インストール方式 ──
+mode=none
+if grep -q 'libscroll-speed' "$PRELOAD" 2>/dev/null; then
+    mode=preload
+    info "方式: /etc/ld.so.preload（全プロセス）"
+fi
+if [[ -f "$DROPIN" ]]; then
+    [[ $mode == preload ]] && warn "ld.so.preload とドロップインの両方に登録されています"
+    mode=compositor
+    info "方式: systemd ドロップイン（gnome-shell のみ）: $DROPIN"
+    if systemctl --user show -p Environment "$UNIT" 2>/dev/null |
+            grep -q 'libscroll-speed'; then
+        ok "$UNIT にドロップインが反映済み"
+    else
+        warn "$UNIT にまだ反映されていません（systemctl --user daemon-reload → 再ログイン）"
+        status=1
+    fi
+fi
+if [[ $mode == none ]]; then
+    err "インストールされていません（ld.so.preload にもドロップインにもなし）"
+    exit 1
+fi
+
+# ── gnome-shell への読み込み ──
+pids=$(pgrep -u "$(id -u)" -x gnome-shell || true)
+if [[ -z $pids ]]; then
+    err "このユーザーの gnome-shell が見つかりません"
+    exit 1
+fi
+for pid in $pids; do
+    if maps_has "$pid" "$LIB_DIR/libscroll-speed.so"; then
+        ok "gnome-shell (pid $pid) にシムが読み込まれています"
+    else
+        err "gnome-shell (pid $pid) にシムが読み込まれていません（再ログインが必要）"
+        status=1
+        continue
+    fi
+    if maps_has "$pid" 'libscroll-speed-engine.so'; then
+        ok "gnome-shell (pid $pid) にエンジンが読み込まれています"
+    else
+        err "エンジンが読み込まれていません（/tmp/scroll-speed-init.log の [engine] を確認）"
+        status=1
+    fi
+done
+
+# ── 限定モード: 他のプロセスに漏れていないか ──
+if [[ $mode == compositor ]]; then
+    leaked=0
+    if maps_has $$ 'libscroll-speed'; then
+        err "このシェルにも読み込まれています（ld.so.preload に残っていませんか）"
+        leaked=1
+    fi
+    for pid in $(pgrep -u "$(id -u)" -x Xwayland || true); do
+        if maps_has "$pid" 'libscroll-speed'; then
+            err "Xwayland (pid $pid) に LD_PRELOAD が引き継がれています"
+            leaked=1
+        fi
+    done
+    if [[ $leaked == 0 ]]; then
+        ok "gnome-shell 以外のプロセスには読み込まれていません"
+    else
+        status=1
+    fi
+fi
+
+# ── 制御ソケット ──
+if command -v "$CTL" &>/dev/null; then
+    if version=$("$CTL" version 2>/dev/null); then
+        ok "制御ソケット応答: $version"
+    else
+        warn "制御ソケットに接続できません（スクロールすると開きます）"
+    fi
+fi
+
+exit $status
@@ -0,0 +1,824 @@
+/*
+ * stress.c — Concurrent stress test of the getters (make stress / make tsan)
+ *
+ * Keeps calling the getters of an LD_PRELOADed libscroll-speed.so
+ * from several threads while, at the same time,
+ *   - the config file is rewritten between two versions (A/B), its
+ *     mtime moved on each time so that the engine reloads it on the
+ *     next stat() check;
+ *   - discrete-scroll-factor is switched between A's and B's value
+ *     through the control socket (snapshot swaps through g_pending);
+ *   - the focused window's PID is switched between this process and
+ *     its parent (the Mutter/GNOME Shell API comes from
+ *     libmutter-stub.so, stub-mutter.h).
+ *
+ * Both configs have dequeue-transform=1.  Odd-numbered threads go
+ * through libinput_dispatch/libinput_get_event first, like Mutter,
+ * and then call the getters (a lookup of the value computed at
+ * dequeue); even-numbered ones only call the getters (the computation
+ * after a failed lookup).
+ *
+ *   -m check  With stateless configs, checks that each result equals
+ *             exactly one of the values precomputed for {A, B} x
+ *             {focused, not}.  A snapshot changing in the middle of a
+ *             call (A's curve with B's app factor, say) gives a "torn"
+ *             result that matches none.  The expected values come
+ *             from A and B alone, in a child forked before any getter
+ *             call.  A call that finds the input lock taken by
+ *             another thread returns its input as is, without
+ *             waiting; that counts as passed through.
+ *   -m state  Turns on prediction, the velocity cap, wheel
+ *             acceleration, the TrackPoint velocity model, physical
+ *             unit profiles and latency-stats, and only checks that
+ *             the results are finite (stats is read from the control
+ *             socket too); races in the stateful stages are for
+ *             ThreadSanitizer (make tsan).  latency-budget is on as
+ *             well, and the focus lookup is stalled for a while: the
+ *             switch to passthrough and the recovery must show in
+ *             stats.  With metrics-file set, the file written must
+ *             have the call, reload and focus cache miss counts.
+ *             With event-tap on, a thread reading the ring must get
+ *             records (with finite values); control edits turn it off
+ *             and on again, so the ring is closed under the getters.  With session-log on at
+ *             a small file size, the rotated files must be at most
+ *             session-log-files and all read back intact.  Both
+ *             configs have monitor-scroll-factor rules too, and a
+ *             "main thread" moves the pointer between two fake
+ *             monitors while turning the main loop (rule picks racing
+ *             config switches and getters, for ThreadSanitizer).  It
+ *             fails if the engine's timeout never ran on the main
+ *             loop.
+ *
+ * Records the time of each call and prints p50/p99/p99.9/max for a
+ * single thread (no rewrites) and under contention.
+ *
+ * Usage:
+ *   LD_PRELOAD=./libscroll-speed.so ./scroll-stress [-m check|state]
+ *                                   [-t THREADS] [-s SECONDS]
+ *   Exit code 1 on a torn result or a non-finite value.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "scroll-speed-log.h"
+#include "scroll-speed-tap.h"
+#include "stub-libinput.h"
+#include "stub-mutter.h"
+
+#define MAX_THREADS     64
+#define MAX_SAMPLES     (1 << 20)     /* latency samples kept per thread */
+#define BASELINE_MS     500
+#define REWRITE_MS      200
+#define FOCUS_USEC      50
+#define EVENT_STEP_USEC 8000
+#define STALL_USEC      5000          /* > latency-budget in state mode */
+#define RECOVER_SEC     10
+#define SESSION_FILES   3             /* state mode: session-log-files */
+
+/* ── Inputs ───────────────────────────────────────────────── */
+
+struct input {
+    enum libinput_event_type type;
+    enum libinput_pointer_axis axis;
+    double value;
+    int    v120;   /* call the v120 getter */
+};
+
+#define FINGER     LIBINPUT_EVENT_POINTER_SCROLL_FINGER
+#define WHEEL      LIBINPUT_EVENT_POINTER_SCROLL_WHEEL
+#define CONTINUOUS LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS
+#define VERT       LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL
+#define HORIZ      LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL
+
+static const struct input g_inputs[] = {
+    { FINGER,     VERT,   0.5,  0 },
+    { FINGER,     VERT,   2.5,  0 },
+    { FINGER,     HORIZ, -4.0,  0 },
+    { FINGER,     VERT,   7.25, 0 },
+    { FINGER,     VERT,  25.0,  0 },
+    { CONTINUOUS, VERT,   3.0,  0 },
+    { CONTINUOUS, HORIZ, -9.0,  0 },
+    { WHEEL,      VERT,  15.0,  0 },
+    { WHEEL,      VERT, -15.0,  1 },
+    { WHEEL,      HORIZ, 30.0,  1 },
+};
+#define NINPUTS (int)(sizeof(g_inputs) / sizeof(g_inputs[0]))
+
+/* ── Configs ──────────────────────────────────────────────── */
+
+/* A and B differ in the curve, the app factor and the wheel factor,
+ * so a call that mixes two snapshots matches neither.  Both turn on
+ * dequeue-transform; workers read events one way or the other.    */
+static const char *const g_conf_text[2] = {
+    "base-speed=0.76\nscroll-cap=21.0\ndiscrete-scroll-factor=1.0\n"
+    "app-scroll-factor=scroll-stress 0.5\ndequeue-transform=1\n",
+    "base-speed=1.2\nscroll-cap=30.0\ndiscrete-scroll-factor=2.0\n"
+    "app-scroll-factor=scroll-stress 2.0\ndequeue-transform=1\n",
+};
+static const char *const g_discrete[2] = { "1.0", "2.0" };
+
+static const char g_state_text[] =
+    "prediction-horizon=16\nstop-velocity-max=1.5\n"
+    "wheel-accel-ramp=0.5\ntrackpoint-velocity-model=1\nlatency-stats=1\n"
+    "latency-budget=2000\nlatency-budget-overruns=4\nevent-tap=1\n"
+    "[profile stress-mm]\nmatch=Stress Touchpad\nphysical-units=1\n";
+
+/* State mode: monitor rules in both configs, so the main-thread
+ * check runs from the first load (file reloads are seconds apart)
+ * and every control edit invalidates the rule it picked           */
+static const char *const g_state_monitor[2] = {
+    "monitor-scroll-factor=eDP-1@2 0.5\n",
+    "monitor-scroll-factor=HDMI-1 1.25\nmonitor-scroll-factor=eDP-1@2 0.5\n",
+};
+
+static int  g_state_mode;
+static char g_dir[64];
+static char g_conf_path[128];
+static char g_prom_path[128];   /* state mode: metrics-file */
+static char g_tap_path[128];    /* state mode: event-tap ring */
+static char g_log_dir[128];     /* state mode: session-log */
+static char g_sock_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+/* Replace the config atomically and give it a fresh mtime: rewrites
+ * within the same second would otherwise look unchanged.          */
+static void write_conf(int which, time_t mtime)
+{
+    char tmp[160];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", g_conf_path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        perror(tmp);
+        exit(1);
+    }
+    fputs(g_conf_text[which], f);
+    if (g_state_mode)
+        fputs(g_state_monitor[which], f);
+    if (g_state_mode)
+        fprintf(f, "%smetrics-file=%s\nmetrics-interval=1\n"
+                "session-log=%s\nsession-log-size=4\nsession-log-files=%d\n",
+                g_state_text, g_prom_path, g_log_dir, SESSION_FILES);
+    fclose(f);
+
+    struct timespec ts[2] = { { mtime, 0 }, { mtime, 0 } };
+    utimensat(AT_FDCWD, tmp, ts, 0);
+    if (rename(tmp, g_conf_path) != 0) {
+        perror(g_conf_path);
+        exit(1);
+    }
+}
+
+/* ── Mutter / GNOME Shell stand-ins ───────────────────────── */
+
+/* libmutter-stub.so windows: this process (its exe matches the
+ * app-scroll-factor rule) and the parent (no rule)               */
+static int g_win_self, g_win_other;
+
+/* ── Workers ──────────────────────────────────────────────── */
+
+static struct libinput_device *g_devices[2];
+
+/* Reference outputs: [config][focus: 0 = other, 1 = self][input] */
+static double (*g_ref)[2][NINPUTS];
+
+struct worker {
+    pthread_t tid;
+    int       id;
+    uint64_t  calls, torn, nonfinite;
+    uint64_t  matched[2];   /* results that match config A / B */
+    uint64_t  raw;          /* passed through: the input lock was taken */
+    uint32_t *lat;          /* ns, first MAX_SAMPLES calls */
+    size_t    nlat;
+};
+
+static atomic_int g_stop;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* dequeue: like Mutter, through libinput_dispatch/get_event, so the
+ * getter looks up the value computed at dequeue time              */
+static double call_getter(const struct input *in, uint64_t t, int dev,
+                          int dequeue)
+{
+    struct libinput_event_pointer *ev =
+        stub_pointer_event(g_devices[dev], in->type, t, in->axis, in->value);
+    if (dequeue) {
+        libinput_dispatch(NULL);
+        libinput_get_event(NULL);
+    }
+    return in->v120
+        ? libinput_event_pointer_get_scroll_value_v120(ev, in->axis)
+        : libinput_event_pointer_get_scroll_value(ev, in->axis);
+}
+
+static void check_result(struct worker *w, int i, double v)
+{
+    if (!isfinite(v)) {
+        w->nonfinite++;
+        return;
+    }
+    if (g_state_mode)
+        return;
+    for (int c = 0; c < 2; c++) {
+        if (v == g_ref[c][0][i] || v == g_ref[c][1][i]) {
+            w->matched[c]++;
+            return;
+        }
+    }
+    const struct input *in = &g_inputs[i];
+    if (v == (in->v120 ? in->value * 8.0 : in->value)) {
+        w->raw++;
+        return;
+    }
+    if (w->torn++ == 0)
+        fprintf(stderr, "torn: thread %d input %d -> %.17g "
+                "(A %.17g/%.17g, B %.17g/%.17g)\n", w->id, i, v,
+                g_ref[0][0][i], g_ref[0][1][i],
+                g_ref[1][0][i], g_ref[1][1][i]);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    /* Threads keep their own clocks; state mode also alternates
+     * devices so the profile cache sees both.                  */
+    uint64_t t = 1000000 + (uint64_t)w->id * 7919;
+    int i = w->id % NINPUTS;
+
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        const struct input *in = &g_inputs[i];
+        int dev = g_state_mode ? (int)(w->calls & 1) : 0;
+
+        uint64_t t0 = now_ns();
+        double v = call_getter(in, t, dev, w->id & 1);
+        uint64_t dt = now_ns() - t0;
+
+        if (w->nlat < MAX_SAMPLES)
+            w->lat[w->nlat++] = dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt;
+        check_result(w, i, v);
+        w->calls++;
+        t += EVENT_STEP_USEC;
+        if (++i == NINPUTS)
+            i = 0;
+    }
+    return NULL;
+}
+
+/* ── Churn threads ────────────────────────────────────────── */
+
+static atomic_ulong g_rewrites, g_edits, g_focus_changes;
+
+static void sleep_us(long us)
+{
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void *rewriter_main(void *arg)
+{
+    (void)arg;
+    time_t mtime = time(NULL);
+    for (int n = 1; !atomic_load(&g_stop); n++) {
+        sleep_us(REWRITE_MS * 1000);
+        write_conf(n & 1, ++mtime);
+        atomic_fetch_add(&g_rewrites, 1);
+    }
+    return NULL;
+}
+
+/* One scroll-speed-ctl style request per connection; the reply
+ * (truncated to size - 1) in reply, -1 if there was none       */
+static ssize_t ctl_query(const char *line, char *reply, size_t size)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", g_sock_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    ssize_t n = -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+        write(fd, line, strlen(line)) == (ssize_t)strlen(line)) {
+        ssize_t r;
+        n = 0;
+        while ((size_t)n < size - 1 &&
+               (r = read(fd, reply + n, size - 1 - (size_t)n)) > 0)
+            n += r;
+    }
+    close(fd);
+    reply[n > 0 ? n : 0] = '\0';
+    return n > 0 ? n : -1;
+}
+
+static int ctl_request(const char *line)
+{
+    char reply[256];
+    return ctl_query(line, reply, sizeof(reply)) >= 2 &&
+           strncmp(reply, "ok", 2) == 0 ? 0 : -1;
+}
+
+static void *editor_main(void *arg)
+{
+    (void)arg;
+    char line[64];
+    for (int n = 0; !atomic_load(&g_stop); n++) {
+        /* The histogram is read while the getters write it */
+        if (g_state_mode && n % 16 == 0)
+            ctl_request("stats\n");
+        /* The ring is closed and reopened under the getters (about
+         * every half second; a file rewrite turns it back on too)  */
+        if (g_state_mode && n % 256 == 0)
+            ctl_request(n & 256 ? "set event-tap 0\n" : "set event-tap 1\n");
+        snprintf(line, sizeof(line), "set discrete-scroll-factor %s\n",
+                 g_discrete[n & 1]);
+        if (ctl_request(line) == 0)
+            atomic_fetch_add(&g_edits, 1);
+        else
+            sleep_us(1000);   /* socket not up yet */
+    }
+    return NULL;
+}
+
+static void *focus_main(void *arg)
+{
+    (void)arg;
+    for (int n = 0; !atomic_load(&g_stop); n++) {
+        stub_focus(n & 1 ? g_win_self : g_win_other);
+        atomic_fetch_add(&g_focus_changes, 1);
+        sleep_us(FOCUS_USEC);
+    }
+    return NULL;
+}
+
+/* State mode: gnome-shell's main thread, moving the pointer between
+ * the two stub monitors and turning the main loop                 */
+static atomic_ulong g_monitor_checks;
+
+static void *mainloop_main(void *arg)
+{
+    (void)arg;
+    for (int n = 0; !atomic_load(&g_stop); n++) {
+        stub_pointer_to(n & 1);
+        atomic_fetch_add(&g_monitor_checks, (unsigned long)stub_main_iterate());
+        sleep_us(1000);
+    }
+    return NULL;
+}
+
+/* State mode: a scroll-speed-tap style reader on the event tap,
+ * attached for the whole run (re-attached if the ring is re-made) */
+static atomic_ulong g_tap_records, g_tap_bad, g_tap_dropped;
+
+static struct ss_tap *tap_attach(void)
+{
+    int fd = open(g_tap_path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(struct ss_tap))
+        p = mmap(NULL, sizeof(struct ss_tap), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+    struct ss_tap *t = p;
+    int32_t none = 0;
+    if (memcmp(t->magic, SS_TAP_MAGIC, sizeof(t->magic)) != 0 ||
+        atomic_load(&t->closed) ||
+        !atomic_compare_exchange_strong(&t->reader, &none, getpid())) {
+        munmap(p, sizeof(*t));
+        return NULL;
+    }
+    return t;
+}
+
+static void *tap_main(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&g_stop)) {
+        struct ss_tap *t = tap_attach();
+        if (!t) {
+            sleep_us(10000);
+            continue;
+        }
+        uint64_t drop0 = atomic_load(&t->dropped);
+        struct ss_tap_record r;
+        while (!atomic_load(&g_stop) && !atomic_load(&t->closed)) {
+            if (!ss_tap_pop(t, &r)) {
+                sleep_us(1000);
+                continue;
+            }
+            atomic_fetch_add(&g_tap_records, 1);
+            if (!isfinite(r.raw) || !isfinite(r.out) ||
+                r.source > SS_TAP_OTHER)
+                atomic_fetch_add(&g_tap_bad, 1);
+        }
+        atomic_fetch_add(&g_tap_dropped, atomic_load(&t->dropped) - drop0);
+        int32_t me = getpid();
+        atomic_compare_exchange_strong(&t->reader, &me, 0);
+        munmap(t, sizeof(*t));
+    }
+    return NULL;
+}
+
+/* State mode: the focus lookup hangs from 1/4 of the run for 3/20
+ * of it, so the getters go over latency-budget and degrade.     */
+static void *staller_main(void *arg)
+{
+    long ms = *(const long *)arg;
+    sleep_us(ms * 250);
+    stub_focus_stall(STALL_USEC);
+    sleep_us(ms * 150);
+    stub_focus_stall(0);
+    return NULL;
+}
+
+/* ── Runs ─────────────────────────────────────────────────── */
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report_latency(const char *label, struct worker *w, int n)
+{
+    size_t total = 0;
+    for (int i = 0; i < n; i++)
+        total += w[i].nlat;
+    uint32_t *all = malloc(total * sizeof(*all));
+    if (!all || !total) {
+        free(all);
+        return;
+    }
+    size_t k = 0;
+    for (int i = 0; i < n; i++) {
+        memcpy(all + k, w[i].lat, w[i].nlat * sizeof(*all));
+        k += w[i].nlat;
+    }
+    qsort(all, total, sizeof(*all), cmp_u32);
+    printf("  latency %-12s p50 %6u  p99 %6u  p99.9 %7u  max %8u ns\n",
+           label, all[total / 2], all[total * 99 / 100],
+           all[total * 999 / 1000], all[total - 1]);
+    free(all);
+}
+
+/* Run n workers for ms milliseconds, with the churn threads if asked */
+static void run(struct worker *w, int n, long ms, int churn)
+{
+    pthread_t churn_tid[6];
+    int nchurn = g_state_mode ? 6 : 3;
+    atomic_store(&g_stop, 0);
+    for (int i = 0; i < n; i++) {
+        free(w[i].lat);
+        memset(&w[i], 0, sizeof(w[i]));
+        w[i].id = i;
+        w[i].lat = malloc(MAX_SAMPLES * sizeof(*w[i].lat));
+        if (!w[i].lat || pthread_create(&w[i].tid, NULL, worker_main, &w[i])) {
+            fprintf(stderr, "worker %d: cannot start\n", i);
+            exit(1);
+        }
+    }
+    if (churn) {
+        pthread_create(&churn_tid[0], NULL, rewriter_main, NULL);
+        pthread_create(&churn_tid[1], NULL, editor_main, NULL);
+        pthread_create(&churn_tid[2], NULL, focus_main, NULL);
+        if (nchurn > 3) {
+            pthread_create(&churn_tid[3], NULL, staller_main, &ms);
+            pthread_create(&churn_tid[4], NULL, tap_main, NULL);
+            pthread_create(&churn_tid[5], NULL, mainloop_main, NULL);
+        }
+    }
+    sleep_us(ms * 1000);
+    atomic_store(&g_stop, 1);
+    for (int i = 0; i < n; i++)
+        pthread_join(w[i].tid, NULL);
+    if (churn)
+        for (int i = 0; i < nchurn; i++)
+            pthread_join(churn_tid[i], NULL);
+}
+
+/* Reference outputs for one config, computed in a child so that its
+ * engine starts from that config alone.  Must run before this
+ * process calls a getter (the engine loads lazily).           */
+static void calibrate(int which)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        unsetenv("SCROLL_SPEED_SOCKET");
+        unsetenv("XDG_RUNTIME_DIR");
+        snprintf(g_conf_path, sizeof(g_conf_path), "%s/ref%d.conf",
+                 g_dir, which);
+        write_conf(which, time(NULL));
+        setenv("SCROLL_SPEED_CONF", g_conf_path, 1);
+
+        int wins[2] = { g_win_other, g_win_self };   /* parent's exe = ours */
+        for (int f = 0; f < 2; f++) {
+            stub_focus(wins[f]);
+            for (int i = 0; i < NINPUTS; i++)
+                g_ref[which][f][i] = call_getter(&g_inputs[i], 1000000, 0, 0);
+        }
+        unlink(g_conf_path);
+        _exit(0);
+    }
+    int st;
+    if (waitpid(pid, &st, 0) < 0 || !WIFEXITED(st) || WEXITSTATUS(st)) {
+        fprintf(stderr, "calibration for config %c failed\n", "AB"[which]);
+        exit(1);
+    }
+}
+
+/* After the state run: the stall must have switched the getters to
+ * passthrough, and the engine's probe must bring them back within
+ * RECOVER_SEC.  Prints the watchdog part of stats; 0 = as expected. */
+static int check_watchdog(void)
+{
+    static char reply[8192];
+    for (int i = 0; i < RECOVER_SEC * 10; i++) {
+        if (ctl_query("stats\n", reply, sizeof(reply)) > 0) {
+            const char *wd = strstr(reply, "# latency budget");
+            if (wd && strstr(wd, "  passthrough  ") &&
+                strstr(wd, "; state full")) {
+                printf("%s", wd);
+                return 0;
+            }
+        }
+        sleep_us(100000);
+    }
+    const char *wd = strstr(reply, "# latency budget");
+    fprintf(stderr, "watchdog: no passthrough and recovery within %d s\n%s",
+            RECOVER_SEC, wd ? wd : reply);
+    return 1;
+}
+
+/* After the state run: the engine thread must have written the
+ * metrics file, with the getter calls, both kinds of reload and the
+ * focus changes counted.  Prints the counters; 0 = as expected.   */
+static int check_metrics(void)
+{
+    static const char *const want[] = {
+        "scroll_speed_getter_calls_total{getter=\"scroll_value\"} ",
+        "scroll_speed_getter_calls_total{getter=\"scroll_value_v120\"} ",
+        "scroll_speed_config_reloads_total{source=\"file\"} ",
+        "scroll_speed_config_reloads_total{source=\"control\"} ",
+        "scroll_speed_focus_cache_misses_total ",
+        "scroll_speed_watchdog_trips_total ",
+    };
+    /* Written every second: wait for one from after the run */
+    sleep_us(1500000);
+    FILE *f = fopen(g_prom_path, "r");
+    if (!f) {
+        perror(g_prom_path);
+        return 1;
+    }
+    int found = 0, bad = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "scroll_speed_config_info", 24) == 0)
+            printf("  %s", line);
+        for (size_t i = 0; i < sizeof(want) / sizeof(want[0]); i++) {
+            size_t n = strlen(want[i]);
+            if (strncmp(line, want[i], n) != 0)
+                continue;
+            printf("  %s", line);
+            found++;
+            if (strtoull(line + n, NULL, 10) == 0)
+                bad++;
+        }
+    }
+    fclose(f);
+    if (found == (int)(sizeof(want) / sizeof(want[0])) && !bad)
+        return 0;
+    fprintf(stderr, "metrics: %d of %zu counters, %d zero\n", found,
+            sizeof(want) / sizeof(want[0]), bad);
+    return 1;
+}
+
+/* After the state run: the engine's timeout ran on the stand-in
+ * main thread.  Prints the count; 0 = as expected.               */
+static int check_monitor(void)
+{
+    unsigned long n = atomic_load(&g_monitor_checks);
+    printf("  monitor checks %lu\n", n);
+    if (n)
+        return 0;
+    fprintf(stderr, "monitor: the main loop ran no timeout\n");
+    return 1;
+}
+
+/* After the state run: the tap reader got records, all of them
+ * sane.  Prints the counts; 0 = as expected.                     */
+static int check_tap(void)
+{
+    unsigned long n = atomic_load(&g_tap_records);
+    unsigned long bad = atomic_load(&g_tap_bad);
+    printf("  tap records %lu, dropped %lu, bad %lu\n", n,
+           atomic_load(&g_tap_dropped), bad);
+    if (n && !bad)
+        return 0;
+    fprintf(stderr, "tap: %s\n", n ? "bad records" : "no records");
+    return 1;
+}
+
+/* After the state run (and check_metrics' wait, so the engine
+ * thread has drained the ring): rotated files, no more than kept,
+ * each one readable to the end.  Prints the totals; 0 = as expected. */
+static int check_session(void)
+{
+    struct dirent **list;
+    int n = scandir(g_log_dir, &list, NULL, alphasort);
+    if (n < 0) {
+        perror(g_log_dir);
+        return 1;
+    }
+    int files = 0, corrupt = 0;
+    unsigned long long events = 0, devices = 0, dropped = 0;
+    for (int i = 0; i < n; i++) {
+        char path[400];
+        snprintf(path, sizeof(path), "%s/%s", g_log_dir, list[i]->d_name);
+        struct ss_log_reader r;
+        if (list[i]->d_name[0] != '.' && ss_log_reader_open(&r, path) == 0) {
+            struct ss_log_event e;
+            int rc;
+            while ((rc = ss_log_next(&r, &e)) > 0) {
+                if (rc == SS_LOG_DEVICE)
+                    devices++;
+                else if (isfinite(e.value))
+                    events++;
+                else
+                    corrupt++;
+            }
+            corrupt += rc < 0;
+            dropped += r.dropped;
+            ss_log_reader_close(&r);
+            files++;
+        }
+        free(list[i]);
+    }
+    free(list);
+    printf("  session log files %d, events %llu, devices %llu, "
+           "dropped %llu, corrupt %d\n", files, events, devices, dropped,
+           corrupt);
+    if (files >= 1 && files <= SESSION_FILES && events && devices &&
+        !corrupt)
+        return 0;
+    fprintf(stderr, "session-log: %d files (at most %d), %s\n", files,
+            SESSION_FILES, corrupt ? "corrupt" : "no events or devices");
+    return 1;
+}
+
+static void cleanup(void)
+{
+    char path[400];
+    unlink(g_conf_path);
+    unlink(g_sock_path);
+    snprintf(path, sizeof(path), "%s.tmp", g_conf_path);
+    unlink(path);
+    unlink(g_prom_path);
+    unlink(g_tap_path);
+    snprintf(path, sizeof(path), "%s.%d.tmp", g_prom_path, (int)getpid());
+    unlink(path);
+    DIR *d = opendir(g_log_dir);
+    struct dirent *e;
+    while (d && (e = readdir(d))) {
+        snprintf(path, sizeof(path), "%s/%s", g_log_dir, e->d_name);
+        if (e->d_name[0] != '.')
+            unlink(path);
+    }
+    if (d)
+        closedir(d);
+    rmdir(g_log_dir);
+    rmdir(g_dir);
+}
+
+int main(int argc, char **argv)
+{
+    int nthreads = 4;
+    double seconds = 5.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:t:s:")) != -1) {
+        switch (opt) {
+        case 'm': g_state_mode = strcmp(optarg, "state") == 0; break;
+        case 't': nthreads = atoi(optarg); break;
+        case 's': seconds = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-m check|state] [-t threads] "
+                    "[-s seconds]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (nthreads < 1 || nthreads > MAX_THREADS || seconds <= 0.0) {
+        fprintf(stderr, "%s: 1..%d threads, seconds > 0\n", argv[0],
+                MAX_THREADS);
+        return 2;
+    }
+
+    snprintf(g_dir, sizeof(g_dir), "/tmp/scroll-stress.XXXXXX");
+    if (!mkdtemp(g_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(g_conf_path, sizeof(g_conf_path), "%s/stress.conf", g_dir);
+    snprintf(g_sock_path, sizeof(g_sock_path), "%s/ctl.sock", g_dir);
+    snprintf(g_prom_path, sizeof(g_prom_path), "%s/scroll-speed.prom", g_dir);
+    snprintf(g_tap_path, sizeof(g_tap_path), "%s/tap", g_dir);
+    snprintf(g_log_dir, sizeof(g_log_dir), "%s/log", g_dir);
+    atexit(cleanup);
+
+    g_devices[0] = stub_device_new("Stress Touchpad", 0x1234, 0x0001,
+                                   100.0, 60.0);
+    g_devices[1] = stub_device_new("Stress Mouse", 0x1234, 0x0002, 0.0, 0.0);
+
+    g_ref = mmap(NULL, sizeof(double[2][2][NINPUTS]), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (g_ref == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    g_win_self = stub_window_new_pid(getpid());
+    g_win_other = stub_window_new_pid(getppid());
+    if (!g_state_mode) {
+        calibrate(0);
+        calibrate(1);
+    } else {
+        stub_monitor_new("eDP-1", 2.0f);    /* both configs have a rule */
+        stub_monitor_new("HDMI-1", 1.0f);
+    }
+
+    write_conf(0, time(NULL));
+    setenv("SCROLL_SPEED_CONF", g_conf_path, 1);
+    setenv("SCROLL_SPEED_SOCKET", g_sock_path, 1);
+    setenv("SCROLL_SPEED_TAP", g_tap_path, 1);
+    stub_focus(g_win_self);
+
+    const char *mode = g_state_mode ? "state" : "check";
+    struct worker *w = calloc(MAX_THREADS, sizeof(*w));
+    if (!w)
+        return 1;
+
+    /* Uncontended: one thread, nothing changing underneath */
+    long base_ms = (long)(seconds * 1000.0) / 4;
+    if (base_ms > BASELINE_MS)
+        base_ms = BASELINE_MS;
+    run(w, 1, base_ms, 0);
+    report_latency("1 thread", w, 1);
+
+    run(w, nthreads, (long)(seconds * 1000.0), 1);
+    uint64_t calls = 0, torn = 0, nonfinite = 0, matched[2] = { 0, 0 };
+    uint64_t raw = 0;
+    for (int i = 0; i < nthreads; i++) {
+        calls += w[i].calls;
+        torn += w[i].torn;
+        nonfinite += w[i].nonfinite;
+        matched[0] += w[i].matched[0];
+        matched[1] += w[i].matched[1];
+        raw += w[i].raw;
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "%d threads", nthreads);
+    report_latency(label, w, nthreads);
+
+    printf("%s: %d threads x %.1f s, %llu calls, %llu torn, "
+           "%llu non-finite\n", mode, nthreads, seconds,
+           (unsigned long long)calls, (unsigned long long)torn,
+           (unsigned long long)nonfinite);
+    printf("  config rewrites %lu, control edits %lu, focus changes %lu\n",
+           atomic_load(&g_rewrites), atomic_load(&g_edits),
+           atomic_load(&g_focus_changes));
+    if (!g_state_mode)
+        printf("  results from config A %llu, B %llu, passed through %llu\n",
+               (unsigned long long)matched[0],
+               (unsigned long long)matched[1], (unsigned long long)raw);
+
+    int wd = g_state_mode ? check_watchdog() : 0;
+    if (g_state_mode)
+        wd |= check_metrics() | check_tap() | check_session() |
+              check_monitor();
+
+    for (int i = 0; i < MAX_THREADS; i++)
+        free(w[i].lat);
+    free(w);
+    return torn || nonfinite || wd ? 1 : 0;
+}
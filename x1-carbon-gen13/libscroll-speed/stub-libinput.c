@@ -0,0 +1,173 @@
+/*
+ * stub-libinput.c — Minimal libinput stub (for replay and benchmarks)
+ *
+ * Lets recorded or synthetic scroll traces be fed into
+ * libscroll-speed.so without libinput-dev or a touchpad: implements
+ * only the getters the interposer resolves with dlsym(RTLD_NEXT) and
+ * a queue of one event (libinput_dispatch / libinput_get_event).
+ *
+ * Build:
+ *   gcc -shared -fPIC -O2 -o libinput-stub.so stub-libinput.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "stub-libinput.h"
+
+struct libinput_device {
+    char         name[64];
+    unsigned int vendor;
+    unsigned int product;
+    double       width, height;
+};
+
+struct libinput_event {
+    enum libinput_event_type type;
+    struct libinput_device *device;
+};
+
+struct libinput_event_pointer {
+    struct libinput_event base;   /* must be first */
+    uint64_t time_usec;
+    double   value[2];
+    double   v120[2];
+    int      has_axis[2];
+};
+
+static __thread struct libinput_event_pointer g_event;   /* per caller */
+static __thread int g_queued;   /* g_event not yet dequeued */
+static struct libinput_device g_devices[STUB_MAX_DEVICES];
+static int g_ndevices;
+
+struct libinput_device *stub_device_new(const char *name,
+                                        unsigned int vendor,
+                                        unsigned int product,
+                                        double width_mm, double height_mm)
+{
+    if (g_ndevices == STUB_MAX_DEVICES)
+        return NULL;
+    struct libinput_device *d = &g_devices[g_ndevices++];
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    d->vendor = vendor;
+    d->product = product;
+    d->width = width_mm;
+    d->height = height_mm;
+    return d;
+}
+
+struct libinput_event_pointer *stub_pointer_event(
+    struct libinput_device *device,
+    enum libinput_event_type type, uint64_t time_usec,
+    enum libinput_pointer_axis axis, double value)
+{
+    memset(&g_event, 0, sizeof(g_event));
+    g_event.base.type = type;
+    g_event.base.device = device;
+    g_event.time_usec = time_usec;
+    g_event.value[axis & 1] = value;
+    if (type == LIBINPUT_EVENT_POINTER_SCROLL_WHEEL)
+        g_event.v120[axis & 1] = value * 8.0;
+    g_event.has_axis[axis & 1] = 1;
+    g_queued = 1;
+    return &g_event;
+}
+
+/* ── libinput API subset ──────────────────────────────────── */
+
+/* The queue holds the caller's last stub_pointer_event() until it is
+ * dequeued; there is no libinput context.                          */
+int libinput_dispatch(struct libinput *libinput)
+{
+    (void)libinput;
+    return 0;
+}
+
+struct libinput_event *libinput_get_event(struct libinput *libinput)
+{
+    (void)libinput;
+    if (!g_queued)
+        return NULL;
+    g_queued = 0;
+    return &g_event.base;
+}
+
+struct libinput_event_pointer *libinput_event_get_pointer_event(
+    struct libinput_event *event)
+{
+    return (struct libinput_event_pointer *)event;
+}
+
+void libinput_event_destroy(struct libinput_event *event)
+{
+    (void)event;
+}
+
+struct libinput_event *libinput_event_pointer_get_base_event(
+    struct libinput_event_pointer *event)
+{
+    return &event->base;
+}
+
+enum libinput_event_type libinput_event_get_type(struct libinput_event *event)
+{
+    return event->type;
+}
+
+struct libinput_device *libinput_event_get_device(struct libinput_event *event)
+{
+    return event->device;
+}
+
+const char *libinput_device_get_name(struct libinput_device *device)
+{
+    return device->name;
+}
+
+unsigned int libinput_device_get_id_vendor(struct libinput_device *device)
+{
+    return device->vendor;
+}
+
+unsigned int libinput_device_get_id_product(struct libinput_device *device)
+{
+    return device->product;
+}
+
+int libinput_device_get_size(struct libinput_device *device,
+                             double *width, double *height)
+{
+    if (device->width <= 0.0 || device->height <= 0.0)
+        return -1;
+    *width = device->width;
+    *height = device->height;
+    return 0;
+}
+
+uint64_t libinput_event_pointer_get_time_usec(
+    struct libinput_event_pointer *event)
+{
+    return event->time_usec;
+}
+
+uint32_t libinput_event_pointer_get_time(struct libinput_event_pointer *event)
+{
+    return (uint32_t)(event->time_usec / 1000);
+}
+
+int libinput_event_pointer_has_axis(struct libinput_event_pointer *event,
+                                    enum libinput_pointer_axis axis)
+{
+    return event->has_axis[axis & 1];
+}
+
+double libinput_event_pointer_get_scroll_value(
+    struct libinput_event_pointer *event, enum libinput_pointer_axis axis)
+{
+    return event->value[axis & 1];
+}
+
+double libinput_event_pointer_get_scroll_value_v120(
+    struct libinput_event_pointer *event, enum libinput_pointer_axis axis)
+{
+    return event->v120[axis & 1];
+}
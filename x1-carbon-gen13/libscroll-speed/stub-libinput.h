@@ -0,0 +1,35 @@
+/*
+ * stub-libinput.h — Helpers of the libinput stub for replay and benchmarks
+ *
+ * libinput-stub.so provides the pointer event getters under the names
+ * of the real libinput.  Test harnesses build synthetic events with
+ * stub_pointer_event() and call the getters through an LD_PRELOADed
+ * libscroll-speed.so.
+ */
+
+#ifndef STUB_LIBINPUT_H
+#define STUB_LIBINPUT_H
+
+#include <stdint.h>
+#include <libinput.h>
+
+/* A synthetic device (at most STUB_MAX_DEVICES, never freed).  With
+ * width or height <= 0, libinput_device_get_size() fails (a device
+ * without resolution information).                              */
+#define STUB_MAX_DEVICES 8
+struct libinput_device *stub_device_new(const char *name,
+                                        unsigned int vendor,
+                                        unsigned int product,
+                                        double width_mm, double height_mm);
+
+/* A synthetic scroll event for one axis, in a per-thread static
+ * buffer that the thread's next call overwrites.  A wheel's v120 is
+ * value x 8 (15 degrees = one click = 120).  device may be NULL.
+ * libinput_get_event() on the same thread hands the event out once
+ * (for callers reading like Mutter: dispatch, get_event, getter). */
+struct libinput_event_pointer *stub_pointer_event(
+    struct libinput_device *device,
+    enum libinput_event_type type, uint64_t time_usec,
+    enum libinput_pointer_axis axis, double value);
+
+#endif
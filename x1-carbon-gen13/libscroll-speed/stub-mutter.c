@@ -0,0 +1,410 @@
+/*
+ * stub-mutter.c — Minimal Mutter/GNOME Shell stub (for replay and stress tests)
+ *
+ * Implements only the four functions the engine's focused_app_rule()
+ * uses, with fake windows and focus scripts; the monitor manager
+ * functions monitor-scroll-factor uses, with fake monitors; and
+ * g_timeout_add_full / g_source_remove of GLib's main loop
+ * (stub-mutter.h).  Linked into the harness (DT_NEEDED, not
+ * LD_PRELOAD).
+ *
+ * Build:
+ *   gcc -shared -fPIC -O2 -o libmutter-stub.so stub-mutter.c
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "stub-mutter.h"
+
+#define SLEEP_BIN    "/bin/sleep"   /* copied under each fake name */
+#define EXEC_WAIT_MS 1000
+#define MAX_SCRIPT   64
+
+struct window {
+    int  pid;
+    int  spawned;           /* ours to kill */
+    char path[160];         /* the copied executable, "" = none */
+};
+
+static int g_shell;         /* ShellGlobal, also the MetaDisplay */
+static struct window g_windows[STUB_MAX_WINDOWS];
+static int g_nwindows;
+static char g_dir[64];      /* fake executables, "" = not made yet */
+
+static atomic_int   g_focus = -1;
+static int          g_script[MAX_SCRIPT];
+static atomic_int   g_script_n;
+static atomic_uint  g_script_every;
+static atomic_ulong g_lookups;
+static atomic_uint  g_stall_usec;
+
+struct monitor {
+    char  connector[32];
+    float scale;
+};
+
+static int g_context, g_backend, g_manager;   /* only their addresses */
+static struct monitor g_monitors[STUB_MAX_MONITORS];
+static atomic_int g_nmonitors;
+static atomic_int g_pointer = -1;
+
+/* g_timeout_add_full's sources, under g_main_lock.  One removed while
+ * dispatching gets its notify once the callback returns (as in GLib). */
+#define MAX_SOURCES 8
+struct source {
+    unsigned id;               /* 0 = free */
+    int    (*func)(void *);
+    void    *data;
+    void   (*notify)(void *);
+    int      dispatching;
+    int      removed;
+};
+static pthread_mutex_t g_main_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct source g_sources[MAX_SOURCES];
+static unsigned g_next_id = 1;
+
+/* ── Mutter / GNOME Shell API ─────────────────────────────── */
+
+void *shell_global_get(void) { return &g_shell; }
+void *shell_global_get_display(void *global) { return global; }
+
+void *meta_display_get_focus_window(void *display)
+{
+    (void)display;
+    unsigned long n = atomic_fetch_add_explicit(&g_lookups, 1,
+                                                memory_order_relaxed);
+    int len = atomic_load_explicit(&g_script_n, memory_order_acquire);
+    if (len > 0) {
+        unsigned every = atomic_load_explicit(&g_script_every,
+                                              memory_order_relaxed);
+        atomic_store_explicit(&g_focus, g_script[(n / every) % len],
+                              memory_order_relaxed);
+    }
+    int w = atomic_load_explicit(&g_focus, memory_order_relaxed);
+    return w >= 0 ? &g_windows[w] : NULL;
+}
+
+int meta_window_get_pid(void *window)
+{
+    unsigned usec = atomic_load_explicit(&g_stall_usec, memory_order_relaxed);
+    if (usec) {
+        struct timespec ts = { usec / 1000000, (usec % 1000000) * 1000L };
+        nanosleep(&ts, NULL);
+    }
+    return ((const struct window *)window)->pid;
+}
+
+int meta_display_get_current_monitor(void *display)
+{
+    (void)display;
+    return atomic_load_explicit(&g_pointer, memory_order_relaxed);
+}
+
+float meta_display_get_monitor_scale(void *display, int monitor)
+{
+    (void)display;
+    if (monitor < 0 || monitor >= atomic_load(&g_nmonitors))
+        return 1.0f;
+    return g_monitors[monitor].scale;
+}
+
+void *meta_display_get_context(void *display) { (void)display; return &g_context; }
+void *meta_context_get_backend(void *context) { (void)context; return &g_backend; }
+void *meta_backend_get_monitor_manager(void *backend)
+{
+    (void)backend;
+    return &g_manager;
+}
+
+int meta_monitor_manager_get_monitor_for_connector(void *manager,
+                                                   const char *connector)
+{
+    (void)manager;
+    int n = atomic_load(&g_nmonitors);
+    for (int i = 0; i < n; i++)
+        if (strcmp(g_monitors[i].connector, connector) == 0)
+            return i;
+    return -1;
+}
+
+/* ── GLib main loop ───────────────────────────────────────── */
+
+/* interval is ignored: each stub_main_iterate() is one period */
+unsigned g_timeout_add_full(int priority, unsigned interval,
+                            int (*func)(void *), void *data,
+                            void (*notify)(void *))
+{
+    (void)priority;
+    (void)interval;
+    unsigned id = 0;
+    pthread_mutex_lock(&g_main_lock);
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        if (g_sources[i].id)
+            continue;
+        g_sources[i] = (struct source){ .id = id = g_next_id++,
+                                        .func = func, .data = data,
+                                        .notify = notify };
+        break;
+    }
+    pthread_mutex_unlock(&g_main_lock);
+    return id;
+}
+
+int g_source_remove(unsigned id)
+{
+    struct source s = {0};
+    pthread_mutex_lock(&g_main_lock);
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        if (!id || g_sources[i].id != id || g_sources[i].removed)
+            continue;
+        if (g_sources[i].dispatching) {
+            g_sources[i].removed = 1;
+        } else {
+            s = g_sources[i];
+            g_sources[i].id = 0;
+        }
+        pthread_mutex_unlock(&g_main_lock);
+        if (s.notify)
+            s.notify(s.data);
+        return 1;
+    }
+    pthread_mutex_unlock(&g_main_lock);
+    return 0;
+}
+
+int stub_main_iterate(void)
+{
+    int n = 0;
+    pthread_mutex_lock(&g_main_lock);
+    for (int i = 0; i < MAX_SOURCES; i++) {
+        struct source *s = &g_sources[i];
+        if (!s->id || s->removed)
+            continue;
+        s->dispatching = 1;
+        pthread_mutex_unlock(&g_main_lock);
+        int again = s->func(s->data);
+        pthread_mutex_lock(&g_main_lock);
+        s->dispatching = 0;
+        n++;
+        if (again && !s->removed)
+            continue;
+        struct source done = *s;
+        s->id = 0;
+        pthread_mutex_unlock(&g_main_lock);
+        if (done.notify)
+            done.notify(done.data);
+        pthread_mutex_lock(&g_main_lock);
+    }
+    pthread_mutex_unlock(&g_main_lock);
+    return n;
+}
+
+int stub_main_sources(void)
+{
+    int n = 0;
+    pthread_mutex_lock(&g_main_lock);
+    for (int i = 0; i < MAX_SOURCES; i++)
+        n += g_sources[i].id && !g_sources[i].removed;
+    pthread_mutex_unlock(&g_main_lock);
+    return n;
+}
+
+/* ── Fake monitors ────────────────────────────────────────── */
+
+int stub_monitor_new(const char *connector, float scale)
+{
+    int n = atomic_load(&g_nmonitors);
+    if (n == STUB_MAX_MONITORS ||
+        strlen(connector) >= sizeof(g_monitors[0].connector)) {
+        errno = EINVAL;
+        return -1;
+    }
+    snprintf(g_monitors[n].connector, sizeof(g_monitors[n].connector),
+             "%s", connector);
+    g_monitors[n].scale = scale > 0.0f ? scale : 1.0f;
+    atomic_store(&g_nmonitors, n + 1);
+    return n;
+}
+
+void stub_pointer_to(int monitor)
+{
+    atomic_store_explicit(&g_pointer,
+                          monitor < atomic_load(&g_nmonitors) ? monitor : -1,
+                          memory_order_relaxed);
+}
+
+int stub_pointer_monitor(void)
+{
+    return atomic_load_explicit(&g_pointer, memory_order_relaxed);
+}
+
+/* ── Fake windows ─────────────────────────────────────────── */
+
+static void cleanup(void)
+{
+    for (int i = 0; i < g_nwindows; i++) {
+        struct window *w = &g_windows[i];
+        if (w->spawned) {
+            kill(w->pid, SIGKILL);
+            waitpid(w->pid, NULL, 0);
+        }
+        if (w->path[0])
+            unlink(w->path);
+    }
+    if (g_dir[0])
+        rmdir(g_dir);
+}
+
+static int copy_file(const char *from, const char *to)
+{
+    int in = open(from, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return -1;
+    int out = open(to, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0755);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0)
+        if (write(out, buf, (size_t)n) != n) {
+            n = -1;
+            break;
+        }
+    close(in);
+    if (close(out) != 0 || n < 0) {
+        unlink(to);
+        return -1;
+    }
+    return 0;
+}
+
+/* Until the child has exec'd, /proc/PID/exe is still ours */
+static int wait_exec(int pid, const char *path)
+{
+    char proc[64], exe[sizeof(((struct window *)0)->path)];
+    snprintf(proc, sizeof(proc), "/proc/%d/exe", pid);
+    for (int ms = 0; ms < EXEC_WAIT_MS; ms++) {
+        ssize_t n = readlink(proc, exe, sizeof(exe) - 1);
+        if (n > 0) {
+            exe[n] = '\0';
+            if (strcmp(exe, path) == 0)
+                return 0;
+        }
+        struct timespec ts = { 0, 1000000 };
+        nanosleep(&ts, NULL);
+    }
+    errno = ETIMEDOUT;
+    return -1;
+}
+
+int stub_window_new(const char *exe)
+{
+    if (g_nwindows == STUB_MAX_WINDOWS || !*exe || strchr(exe, '/')) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!g_dir[0]) {
+        snprintf(g_dir, sizeof(g_dir), "/tmp/stub-mutter.XXXXXX");
+        if (!mkdtemp(g_dir)) {
+            g_dir[0] = '\0';
+            return -1;
+        }
+        atexit(cleanup);
+    }
+
+    struct window *w = &g_windows[g_nwindows];
+    int n = snprintf(w->path, sizeof(w->path), "%s/%s", g_dir, exe);
+    if (n < 0 || (size_t)n >= sizeof(w->path)) {
+        w->path[0] = '\0';
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (copy_file(SLEEP_BIN, w->path) != 0) {
+        w->path[0] = '\0';
+        return -1;
+    }
+
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        unlink(w->path);
+        w->path[0] = '\0';
+        return -1;
+    }
+    if (pid == 0) {
+        /* Gone with the harness, however it ends */
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent)
+            _exit(1);
+        char *const argv[] = { (char *)exe, (char *)"infinity", NULL };
+        char *const envp[] = { NULL };
+        execve(w->path, argv, envp);
+        _exit(127);
+    }
+    w->pid = pid;
+    w->spawned = 1;
+    g_nwindows++;
+    if (wait_exec(pid, w->path) != 0)
+        return -1;   /* cleaned up at exit */
+    return g_nwindows - 1;
+}
+
+int stub_window_new_pid(int pid)
+{
+    if (g_nwindows == STUB_MAX_WINDOWS) {
+        errno = EINVAL;
+        return -1;
+    }
+    g_windows[g_nwindows].pid = pid;
+    return g_nwindows++;
+}
+
+/* ── Focus ────────────────────────────────────────────────── */
+
+void stub_focus(int window)
+{
+    atomic_store_explicit(&g_script_n, 0, memory_order_relaxed);
+    atomic_store_explicit(&g_focus, window < g_nwindows ? window : -1,
+                          memory_order_relaxed);
+}
+
+void stub_focus_script(const int *seq, int n, unsigned every)
+{
+    atomic_store_explicit(&g_script_n, 0, memory_order_relaxed);
+    if (n > MAX_SCRIPT)
+        n = MAX_SCRIPT;
+    for (int i = 0; i < n; i++)
+        g_script[i] = seq[i] < g_nwindows ? seq[i] : -1;
+    atomic_store_explicit(&g_script_every, every ? every : 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&g_script_n, n > 0 ? n : 0, memory_order_release);
+}
+
+int stub_focused(void)
+{
+    return atomic_load_explicit(&g_focus, memory_order_relaxed);
+}
+
+void stub_focus_stall(unsigned usec)
+{
+    atomic_store_explicit(&g_stall_usec, usec, memory_order_relaxed);
+}
+
+unsigned long stub_focus_lookups(void)
+{
+    return atomic_load_explicit(&g_lookups, memory_order_relaxed);
+}
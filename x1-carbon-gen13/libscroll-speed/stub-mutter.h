@@ -0,0 +1,79 @@
+/*
+ * stub-mutter.h — Helpers of the Mutter/GNOME Shell stub (replay, stress tests)
+ *
+ * libmutter-stub.so provides, under the same names, the functions the
+ * engine resolves with dlsym(RTLD_DEFAULT) to find the focused app
+ * (shell_global_get, shell_global_get_display,
+ * meta_display_get_focus_window, meta_window_get_pid).  Linked into a
+ * harness (DT_NEEDED, so in the global scope), it lets per-app
+ * factors, the focus cache and focus switches run outside gnome-shell.
+ *
+ * A fake window has one PID.  The engine tells apps apart by the path
+ * of /proc/PID/exe, so stub_window_new() puts an executable of the
+ * given name (a copy of /bin/sleep) in a temporary directory, starts
+ * it and uses its PID.  The processes and temporary files are cleaned
+ * up at exit (and when the parent dies).  Focus changes and script
+ * steps may come from other threads.
+ *
+ * For monitor-scroll-factor it also provides the monitor manager
+ * functions (meta_display_get_current_monitor,
+ * meta_display_get_monitor_scale, meta_display_get_context →
+ * meta_context_get_backend → meta_backend_get_monitor_manager,
+ * meta_monitor_manager_get_monitor_for_connector), and GLib's
+ * g_timeout_add_full / g_source_remove, with which the engine checks
+ * on gnome-shell's main thread.  No main loop runs: wherever the
+ * harness calls stub_main_iterate() is the "main thread" (timeout
+ * intervals are ignored).
+ */
+
+#ifndef STUB_MUTTER_H
+#define STUB_MUTTER_H
+
+#define STUB_MAX_WINDOWS  16
+#define STUB_MAX_MONITORS 8
+
+/* Start a process whose executable is named exe (no "/") and make a
+ * window for it.  Returns the window number, -1 on failure (errno). */
+int stub_window_new(const char *exe);
+
+/* A window of an existing process (this one, the parent...).  With
+ * pid <= 0, meta_window_get_pid() returns it as is (no app).     */
+int stub_window_new_pid(int pid);
+
+/* Focus window (-1 = none: meta_display_get_focus_window() returns
+ * NULL).  Stops the script.                                       */
+void stub_focus(int window);
+
+/* Focus script: step through seq[0..n-1], one every `every` focus
+ * lookups (meta_display_get_focus_window), back to the start after
+ * the last.  n = 0 stops it (the focus stays where it is).        */
+void stub_focus_script(const int *seq, int n, unsigned every);
+
+/* The focused window (-1 = none) */
+int stub_focused(void);
+
+/* meta_window_get_pid() stalls usec each time (0 = not at all): a
+ * stuck gnome-shell, for checking latency-budget.               */
+void stub_focus_stall(unsigned usec);
+
+/* Focus lookups so far (the times the engine looked the app up) */
+unsigned long stub_focus_lookups(void);
+
+/* Add a monitor with connector name connector ("eDP-1"...) at scale
+ * scale.  Returns its number (Mutter's monitor index), -1 on failure. */
+int stub_monitor_new(const char *connector, float scale);
+
+/* Move the pointer to monitor (-1 = on none) */
+void stub_pointer_to(int monitor);
+
+/* The monitor the pointer is on (-1 = none) */
+int stub_pointer_monitor(void);
+
+/* One turn of the main loop: call each registered timeout's callback
+ * once and remove those that return FALSE.  Returns how many ran.  */
+int stub_main_iterate(void);
+
+/* Registered timeouts (whether the engine is checking) */
+int stub_main_sources(void);
+
+#endif
@@ -1,14 +1,21 @@
 #!/usr/bin/env bash
 # uninstall.sh — libscroll-speed のアンインストール
 #
-# ld.so.preload からエントリを削除し、ライブラリと設定ファイルを除去します。
+# ld.so.preload のエントリ・gnome-shell 用 systemd ドロップインを削除し、
+# ライブラリと設定ファイルを除去します。
 # 反映にはログアウト→再ログインが必要です。
 
 set -euo pipefail
 
 LIB_PATH="/usr/local/lib/x86_64-linux-gnu/libscroll-speed.so"
+ENGINE_PATH="/usr/local/lib/x86_64-linux-gnu/libscroll-speed-engine.so"
 PRELOAD="/etc/ld.so.preload"
+CTL_PATH="/usr/local/bin/scroll-speed-ctl"
+TAP_PATH="/usr/local/bin/scroll-speed-tap"
+LOGDUMP_PATH="/usr/local/bin/scroll-speed-logdump"
 CONF="/etc/scroll-speed.conf"
+DROPIN_DIR="/etc/systemd/user/org.gnome.Shell@wayland.service.d"
+DROPIN="$DROPIN_DIR/libscroll-speed.conf"
 
 info()  { echo -e "\033[1;34m[INFO]\033[0m  $*"; }
 ok()    { echo -e "\033[1;32m[OK]\033[0m    $*"; }
@@ -22,6 +29,16 @@ else
     info "ld.so.preload にエントリなし（スキップ）"
 fi
 
+# ── systemd ドロップイン削除（gnome-shell 限定モード） ──
+if [[ -f "$DROPIN" ]]; then
+    sudo rm -f "$DROPIN"
+    sudo rmdir "$DROPIN_DIR" 2>/dev/null || true
+    systemctl --user daemon-reload 2>/dev/null || true
+    ok "systemd ドロップインを削除: $DROPIN"
+else
+    info "systemd ドロップインなし（スキップ）"
+fi
+
 # ── ライブラリ削除 ──
 if [[ -f "$LIB_PATH" ]]; then
     sudo rm -f "$LIB_PATH"
@@ -30,9 +47,15 @@ else
     info "ライブラリなし: $LIB_PATH（スキップ）"
 fi
 
+# ── エンジン削除（シンボリックリンクとバージョン付きファイル） ──
+sudo rm -f "$ENGINE_PATH" "$ENGINE_PATH".*
+
+# ── 管理コマンド削除 ──
+sudo rm -f "$CTL_PATH" "$TAP_PATH" "$LOGDUMP_PATH"
+
 # ── 設定ファイル削除 ──
-if [[ -f "$CONF" ]]; then
-    sudo rm -f "$CONF"
+if [[ -f "$CONF" || -f "$CONF.bin" ]]; then
+    sudo rm -f "$CONF" "$CONF.bin"
     ok "設定ファイルを削除: $CONF"
 else
     info "設定ファイルなし（スキップ）"